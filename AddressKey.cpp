@@ -0,0 +1,136 @@
+#include "AddressKey.hpp"
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+
+namespace {
+    // An overlong name is stored as: a zero first byte, its pool id in the next four bytes,
+    // and a 1 in the last byte. Inline names always end in a zero byte, so the two can't be confused.
+    const int ID_OFFSET = 1;
+    const char INTERNED = 1;
+
+    // The global pool of names too long to store inline. Ids index into an append-only table of
+    // fixed-size chunks that never move, so reading a name takes no lock: whoever holds a key with an
+    // id got it from storeName, after the name was in place. Only interning takes the lock.
+    const std::uint32_t CHUNK_NAMES = 4096;
+    const std::uint32_t MAX_CHUNKS = 1024;
+
+    struct NamePool {
+        std::mutex lock; // held while interning
+        std::atomic<std::string*> chunks[MAX_CHUNKS];
+        std::uint32_t count;
+        std::unordered_map<std::string, std::uint32_t> ids;
+
+        NamePool() : count(0) {
+            for (std::atomic<std::string*>& chunk : chunks) {
+                chunk.store(nullptr, std::memory_order_relaxed);
+            }
+        }
+    };
+
+    NamePool& namePool() {
+        static NamePool pool;
+        return pool;
+    }
+
+    const std::string& pooledName(std::uint32_t id) {
+        std::string* chunk = namePool().chunks[id / CHUNK_NAMES].load(std::memory_order_acquire);
+        return chunk[id % CHUNK_NAMES];
+    }
+
+    void storeName(char (&field)[AddressKey::NAME_CAPACITY], const std::string& name) {
+        if (name.size() < static_cast<std::size_t>(AddressKey::NAME_CAPACITY)) {
+            std::memcpy(field, name.data(), name.size());
+            return;
+        }
+        NamePool& pool = namePool();
+        std::uint32_t id;
+        {
+            std::lock_guard<std::mutex> guard(pool.lock);
+            auto found = pool.ids.find(name);
+            if (found != pool.ids.end()) {
+                id = found->second;
+            } else {
+                id = pool.count;
+                if (id / CHUNK_NAMES >= MAX_CHUNKS) {
+                    throw std::runtime_error("AddressKey: error, too many long street and city names");
+                }
+                std::string* chunk = pool.chunks[id / CHUNK_NAMES].load(std::memory_order_relaxed);
+                if (chunk == nullptr) {
+                    chunk = new std::string[CHUNK_NAMES];
+                }
+                chunk[id % CHUNK_NAMES] = name;
+                pool.chunks[id / CHUNK_NAMES].store(chunk, std::memory_order_release);
+                pool.count++;
+                pool.ids.emplace(name, id);
+            }
+        }
+        std::memcpy(field + ID_OFFSET, &id, sizeof(id));
+        field[AddressKey::NAME_CAPACITY - 1] = INTERNED;
+    }
+
+    bool isInterned(const char (&field)[AddressKey::NAME_CAPACITY]) {
+        return field[AddressKey::NAME_CAPACITY - 1] == INTERNED;
+    }
+
+    // The name in a field, inline or pooled, without copying it
+    std::string_view viewName(const char (&field)[AddressKey::NAME_CAPACITY]) {
+        if (!isInterned(field)) {
+            return std::string_view(field, strnlen(field, AddressKey::NAME_CAPACITY));
+        }
+        std::uint32_t id;
+        std::memcpy(&id, field + ID_OFFSET, sizeof(id));
+        return pooledName(id);
+    }
+
+    // Compares two names like std::string::compare does
+    int compareNames(const char (&a)[AddressKey::NAME_CAPACITY], const char (&b)[AddressKey::NAME_CAPACITY]) {
+        if (!isInterned(a) && !isInterned(b)) {
+            // zero padding makes a plain byte compare lexicographic
+            return std::memcmp(a, b, AddressKey::NAME_CAPACITY);
+        }
+        return viewName(a).compare(viewName(b));
+    }
+}
+
+AddressKey::AddressKey(const StreetAddress& address) {
+    std::memset(this, 0, sizeof(AddressKey));
+    number = address.number;
+    zip = address.zip;
+    storeName(street, address.street);
+    storeName(city, address.city);
+}
+
+StreetAddress AddressKey::toStreetAddress() const {
+    StreetAddress address;
+    address.number = number;
+    address.street = streetName();
+    address.city = cityName();
+    address.zip = zip;
+    return address;
+}
+
+std::string AddressKey::streetName() const {
+    return std::string(viewName(street));
+}
+
+std::string AddressKey::cityName() const {
+    return std::string(viewName(city));
+}
+
+bool AddressKey::operator<(const AddressKey& other) const {
+    if (zip != other.zip) {
+        return zip < other.zip;
+    }
+    int order = compareNames(city, other.city);
+    if (order != 0) {
+        return order < 0;
+    }
+    order = compareNames(street, other.street);
+    if (order != 0) {
+        return order < 0;
+    }
+    return number < other.number;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "StreetAddress.hpp"
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+// A fixed-size copy of a StreetAddress for use as a dictionary key.
+// Street and city are stored inline in zero-padded arrays, so a key is one contiguous,
+// trivially copyable block: equality and hashing both read it a word at a time.
+// Names that don't fit are interned in a global pool (reading one back takes no lock) and the
+// array holds the pool id instead, so equal names still have equal bytes.
+struct AddressKey {
+    static const int NAME_CAPACITY = 16; // bytes per name; names up to NAME_CAPACITY - 1 chars are inline
+
+    int number;
+    int zip;
+    char street[NAME_CAPACITY];
+    char city[NAME_CAPACITY];
+
+    AddressKey() {
+        std::memset(this, 0, sizeof(AddressKey));
+    }
+
+    explicit AddressKey(const StreetAddress& address);
+
+    // The address this key was made from
+    StreetAddress toStreetAddress() const;
+    std::string streetName() const;
+    std::string cityName() const;
+
+    // compares the keys as whole 64-bit words: number and zip share the first word, which rejects
+    // almost every mismatch, and the names are compared without branching on each field
+    bool operator==(const AddressKey& other) const {
+        const char* a = reinterpret_cast<const char*>(this);
+        const char* b = reinterpret_cast<const char*>(&other);
+        std::uint64_t x;
+        std::uint64_t y;
+        std::memcpy(&x, a, sizeof(x));
+        std::memcpy(&y, b, sizeof(y));
+        if (x != y) {
+            return false;
+        }
+        std::uint64_t difference = 0;
+        for (std::size_t i = sizeof(x); i < sizeof(AddressKey); i += sizeof(x)) {
+            std::memcpy(&x, a + i, sizeof(x));
+            std::memcpy(&y, b + i, sizeof(y));
+            difference |= x ^ y;
+        }
+        return difference == 0;
+    }
+
+    bool operator!=(const AddressKey& other) const {
+        return !(*this == other);
+    }
+
+    // Same order as StreetAddress: zip, then city, then street, then number
+    bool operator<(const AddressKey& other) const;
+};
+
+// comparing and hashing whole words relies on there being no padding bytes
+static_assert(sizeof(AddressKey) == 2 * sizeof(int) + 2 * AddressKey::NAME_CAPACITY, "AddressKey has padding");
+static_assert(sizeof(AddressKey) % sizeof(std::uint64_t) == 0, "AddressKey is not a whole number of words");
+static_assert(std::is_trivially_copyable<AddressKey>::value, "AddressKey must be trivially copyable");
@@ -0,0 +1,186 @@
+#include "AsyncLogSink.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <unistd.h>
+
+AsyncLogSink::AsyncLogSink(int f, bool owns, std::size_t size, int count)
+    : fd(f), ownsFd(owns), chunkSize(size), writing(false), stopping(false), written(0) {
+    if (chunkSize < 64 || count < 2) {
+        throw std::invalid_argument("AsyncLogSink: need at least 2 buffers of 64 bytes");
+    }
+    for (int i = 0; i < count; i++) {
+        Chunk* chunk = new Chunk;
+        chunk->data = new char[chunkSize];
+        chunk->used = 0;
+        allChunks.push_back(chunk);
+        freeChunks.push_back(chunk);
+    }
+    writer = std::thread(&AsyncLogSink::writeLoop, this);
+}
+
+AsyncLogSink::~AsyncLogSink() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    workReady.notify_one();
+    writer.join();
+    for (Chunk* chunk : allChunks) {
+        delete[] chunk->data;
+        delete chunk;
+    }
+    if (ownsFd) {
+        close(fd);
+    }
+}
+
+void AsyncLogSink::writeLoop() {
+    std::unique_lock<std::mutex> guard(lock);
+    while (true) {
+        workReady.wait(guard, [this] { return stopping || !fullChunks.empty(); });
+        if (fullChunks.empty()) {
+            break; // stopping, and everything has been written
+        }
+        Chunk* chunk = fullChunks.front();
+        fullChunks.pop_front();
+        writing = true;
+        guard.unlock();
+
+        // the actual write happens without the lock, so producers can keep submitting
+        std::size_t done = 0;
+        std::string failure;
+        while (done < chunk->used) {
+            ssize_t n = ::write(fd, chunk->data + done, chunk->used - done);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                failure = std::strerror(errno);
+                break;
+            }
+            done += static_cast<std::size_t>(n);
+        }
+
+        guard.lock();
+        writing = false;
+        written += static_cast<long long>(done);
+        if (!failure.empty() && error.empty()) {
+            error = failure;
+        }
+        chunk->used = 0;
+        freeChunks.push_back(chunk);
+        chunkFree.notify_one();
+        if (fullChunks.empty()) {
+            drained.notify_all();
+        }
+    }
+}
+
+AsyncLogSink::Chunk* AsyncLogSink::acquire() {
+    std::unique_lock<std::mutex> guard(lock);
+    chunkFree.wait(guard, [this] { return !freeChunks.empty(); });
+    Chunk* chunk = freeChunks.front();
+    freeChunks.pop_front();
+    return chunk;
+}
+
+void AsyncLogSink::submit(Chunk* chunk) {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (chunk->used == 0) {
+            freeChunks.push_back(chunk);
+            chunkFree.notify_one();
+            return;
+        }
+        fullChunks.push_back(chunk);
+    }
+    workReady.notify_one();
+}
+
+void AsyncLogSink::flush() {
+    std::unique_lock<std::mutex> guard(lock);
+    drained.wait(guard, [this] { return fullChunks.empty() && !writing; });
+    if (!error.empty()) {
+        std::string failure = error;
+        error.clear(); // reported once; later writes may well succeed
+        throw std::runtime_error("AsyncLogSink: write failed: " + failure);
+    }
+}
+
+long long AsyncLogSink::bytesWritten() {
+    std::lock_guard<std::mutex> guard(lock);
+    return written;
+}
+
+int AsyncLogSink::openFile(const std::string& path) {
+    if (path == "-") {
+        return STDOUT_FILENO;
+    }
+    int f = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (f < 0) {
+        throw std::runtime_error("AsyncLogSink: can't open " + path + ": " + std::strerror(errno));
+    }
+    return f;
+}
+
+// Producer
+
+AsyncLogSink::Producer::Producer(AsyncLogSink& s) : sink(s), chunk(s.acquire()) {}
+
+AsyncLogSink::Producer::~Producer() {
+    sink.submit(chunk);
+}
+
+void AsyncLogSink::Producer::reserve(std::size_t n) {
+    if (chunk->used + n > sink.chunkSize) {
+        submit();
+    }
+}
+
+void AsyncLogSink::Producer::submit() {
+    sink.submit(chunk);
+    chunk = sink.acquire();
+}
+
+void AsyncLogSink::Producer::append(const char* text, std::size_t length) {
+    // text longer than what's left is split across buffers
+    while (length > 0) {
+        if (chunk->used == sink.chunkSize) {
+            submit();
+        }
+        std::size_t n = std::min(length, sink.chunkSize - chunk->used);
+        std::memcpy(chunk->data + chunk->used, text, n);
+        chunk->used += n;
+        text += n;
+        length -= n;
+    }
+}
+
+void AsyncLogSink::Producer::append(const char* text) {
+    append(text, std::strlen(text));
+}
+
+void AsyncLogSink::Producer::append(const std::string& text) {
+    append(text.data(), text.size());
+}
+
+void AsyncLogSink::Producer::append(char c) {
+    reserve(1);
+    chunk->data[chunk->used++] = c;
+}
+
+void AsyncLogSink::Producer::append(int number) {
+    append(static_cast<long long>(number));
+}
+
+void AsyncLogSink::Producer::append(long long number) {
+    const std::size_t MAX_DIGITS = 20; // including the sign
+    reserve(MAX_DIGITS);
+    char* start = chunk->data + chunk->used;
+    auto result = std::to_chars(start, start + MAX_DIGITS, number);
+    chunk->used += static_cast<std::size_t>(result.ptr - start);
+}
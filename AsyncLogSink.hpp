@@ -0,0 +1,102 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Text output that is formatted into large in-memory buffers and written to a file descriptor
+// by a background thread, so the thread producing the text never waits on the disk or terminal
+// (unless every buffer is full, which throttles it to the speed of the writer).
+//
+// Producing threads each create their own Producer, which owns the buffer currently being filled;
+// full buffers are handed to the writer thread and come back to a shared pool once written.
+class AsyncLogSink {
+private:
+    // One buffer of text
+    struct Chunk {
+        char* data;
+        std::size_t used;
+    };
+
+    int fd;                // where the text goes
+    bool ownsFd;           // whether to close fd in the destructor
+    std::size_t chunkSize; // capacity of each buffer
+
+    std::mutex lock;
+    std::condition_variable chunkFree;   // signalled when a buffer returns to the pool
+    std::condition_variable workReady;   // signalled when a buffer is submitted, or on shutdown
+    std::condition_variable drained;     // signalled when the writer has nothing left to do
+    std::deque<Chunk*> freeChunks;       // buffers waiting to be filled
+    std::deque<Chunk*> fullChunks;       // buffers waiting to be written
+    std::deque<Chunk*> allChunks;        // every buffer, for the destructor
+    bool writing;                        // whether the writer is in the middle of a write
+    bool stopping;                       // set by the destructor
+    long long written;                   // bytes written so far
+    std::string error;                   // first write error since flush() last reported one
+
+    std::thread writer;
+
+    // The writer thread's loop
+    void writeLoop();
+
+    // Takes an empty buffer from the pool, waiting for one if needed
+    Chunk* acquire();
+
+    // Queues a buffer for writing (or straight back to the pool if it's empty)
+    void submit(Chunk* chunk);
+
+public:
+    // A producing thread's handle: formats text into its own buffer
+    class Producer {
+    private:
+        AsyncLogSink& sink;
+        Chunk* chunk;
+
+        // Makes sure at least `n` bytes (at most the buffer size) fit in the current buffer
+        void reserve(std::size_t n);
+
+    public:
+        explicit Producer(AsyncLogSink& sink);
+
+        // Hands off whatever is left in the buffer
+        ~Producer();
+
+        Producer(const Producer&) = delete;
+        Producer& operator=(const Producer&) = delete;
+
+        void append(const char* text, std::size_t length);
+        void append(const char* text);
+        void append(const std::string& text);
+        void append(char c);
+        void append(int number);
+        void append(long long number);
+
+        // Hands the current buffer to the writer thread without waiting for it to be written
+        void submit();
+    };
+
+    // Writes to `fd` through `chunkCount` buffers of `chunkSize` bytes each
+    AsyncLogSink(int fd, bool ownsFd = false, std::size_t chunkSize = 1 << 20, int chunkCount = 4);
+
+    // Writes everything still queued, stops the writer and releases the buffers
+    ~AsyncLogSink();
+
+    AsyncLogSink(const AsyncLogSink&) = delete;
+    AsyncLogSink& operator=(const AsyncLogSink&) = delete;
+
+    // Waits until every submitted buffer has been written.
+    // Throws a runtime_error if a write failed since the last flush(). The text of a failed write
+    // is lost, but the sink keeps taking and writing text, so once the fd recovers later lines
+    // get through and the next flush() succeeds.
+    void flush();
+
+    // How many bytes have been written to fd so far
+    long long bytesWritten();
+
+    // Opens (creating or truncating) a file for a sink to write to; "-" means standard output.
+    // Throws a runtime_error if the file can't be opened.
+    static int openFile(const std::string& path);
+};
@@ -0,0 +1,554 @@
+#pragma once
+
+#include "Dictionary.hpp"
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+// An ordered dictionary: a B+-tree with wide nodes, all records in the leaves,
+// and the leaves linked in key order so range scans walk them sequentially.
+// Keys and values are kept in separate arrays within a leaf, and inner nodes hold only
+// keys and child pointers, so a search touches few cache lines per level.
+// Keys are ordered by `Less` (std::less, i.e. operator<, by default).
+template<typename Key, typename Val, typename Less = std::less<Key>>
+class BPlusTree : public Dictionary<Key, Val> {
+private:
+    static const int LEAF_CAPACITY = 32;   // records per leaf
+    static const int INNER_CAPACITY = 64;  // children per inner node
+    static const int MIN_LEAF = LEAF_CAPACITY / 2;            // fewer records than this: rebalance
+    static const int MIN_INNER = (INNER_CAPACITY - 1) / 2;    // fewer keys than this: rebalance
+
+    // what leaves and inner nodes have in common
+    struct Node {
+        bool leaf;
+        int count; // records in a leaf, keys in an inner node (which has count + 1 children)
+
+        Node(bool isLeaf) : leaf(isLeaf), count(0) {}
+    };
+
+    struct Leaf : Node {
+        Key keys[LEAF_CAPACITY];
+        Val vals[LEAF_CAPACITY];
+        Leaf* prev;
+        Leaf* next;
+
+        Leaf() : Node(true), prev(nullptr), next(nullptr) {}
+    };
+
+    // children[i] holds keys below keys[i]; children[i + 1] holds keys from keys[i] up
+    struct Inner : Node {
+        Key keys[INNER_CAPACITY - 1];
+        Node* children[INNER_CAPACITY];
+
+        Inner() : Node(false) {}
+    };
+
+    Node* root;
+    Leaf* head;     // leftmost leaf
+    int length;     // number of records
+    int leaves;     // number of leaves
+    Less less;
+
+    // the leaves in list order, so forEachInRange can start at any one of them; rebuilt by the first
+    // forEachInRange after a leaf is split or merged away (the lock lets several threads scan at once)
+    mutable std::vector<const Leaf*> leafIndex;
+    mutable bool leafIndexStale;
+    mutable std::mutex leafIndexLock;
+
+    // the leaf at position i of the list, or null past the end
+    const Leaf* leafAt(int i) const;
+
+    bool equal(const Key& a, const Key& b) const {
+        return !less(a, b) && !less(b, a);
+    }
+
+    // the first position in keys[0 .. n) whose key is not below k
+    int lowerBound(const Key* keys, int n, const Key& k) const;
+
+    // which child of an inner node k belongs in
+    int childIndex(const Inner* inner, const Key& k) const;
+
+    // the leaf k belongs in
+    Leaf* findLeaf(const Key& k) const;
+
+    // Inserts or updates below `node`. If `node` had to split, returns the new right sibling
+    // and the smallest key under it in `splitKey`; otherwise returns null.
+    // `added` is set if a new record was created rather than updated.
+    Node* insertInto(Node* node, const Key& k, const Val& v, Key& splitKey, bool& added);
+
+    // Removes k from below `node`, fixing up any child that becomes too small.
+    // Returns false if k wasn't there.
+    bool removeFrom(Node* node, const Key& k);
+
+    // Brings parent->children[i] back to the minimum size by borrowing from or merging with a sibling
+    void rebalance(Inner* parent, int i);
+
+    // Removes keys[i] and children[i + 1] from an inner node
+    void removeFromInner(Inner* inner, int i);
+
+    void destroy(Node* node);
+
+public:
+    BPlusTree();
+    virtual ~BPlusTree();
+
+    // Nodes are owned by the tree, so trees can't be copied
+    BPlusTree(const BPlusTree&) = delete;
+    BPlusTree& operator=(const BPlusTree&) = delete;
+
+    // dictionary interface methods
+    virtual void clear() override;
+    virtual Val find(const Key&) const override;
+    virtual void insert(const Key&, const Val&) override;
+    virtual void remove(const Key&) override;
+    virtual int size() const override;
+
+    // storage positions are leaves, in key order
+    virtual int slotCount() const override;
+    virtual void reserve(int capacity) override; // no-op: the tree splits leaves as it grows
+    virtual void forEachInRange(int begin, int end,
+                                const std::function<void(const Key&, const Val&)>& visit) const override;
+
+    // Calls visit(key, value) for every record with low <= key <= high, in key order
+    void rangeScan(const Key& low, const Key& high, const std::function<void(const Key&, const Val&)>& visit) const;
+
+    // Calls visit(key, value) for records from the first key >= low onwards, in key order,
+    // until visit returns false (useful when the end of the range is a condition rather than a key)
+    void scanFrom(const Key& low, const std::function<bool(const Key&, const Val&)>& visit) const;
+
+    // Number of levels, counting the leaves
+    int height() const;
+};
+
+// implementation
+
+template<typename Key, typename Val, typename Less>
+BPlusTree<Key, Val, Less>::BPlusTree() : length(0), leaves(1), leafIndexStale(true) {
+    head = new Leaf;
+    root = head;
+}
+
+template<typename Key, typename Val, typename Less>
+BPlusTree<Key, Val, Less>::~BPlusTree() {
+    destroy(root);
+}
+
+template<typename Key, typename Val, typename Less>
+void BPlusTree<Key, Val, Less>::destroy(Node* node) {
+    if (!node->leaf) {
+        Inner* inner = static_cast<Inner*>(node);
+        for (int i = 0; i <= inner->count; i++) {
+            destroy(inner->children[i]);
+        }
+        delete inner;
+    } else {
+        delete static_cast<Leaf*>(node);
+    }
+}
+
+template<typename Key, typename Val, typename Less>
+void BPlusTree<Key, Val, Less>::clear() {
+    destroy(root);
+    head = new Leaf;
+    root = head;
+    length = 0;
+    leaves = 1;
+    leafIndexStale = true;
+}
+
+template<typename Key, typename Val, typename Less>
+int BPlusTree<Key, Val, Less>::lowerBound(const Key* keys, int n, const Key& k) const {
+    int low = 0;
+    int high = n;
+    while (low < high) {
+        int mid = (low + high) / 2;
+        if (less(keys[mid], k)) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+template<typename Key, typename Val, typename Less>
+int BPlusTree<Key, Val, Less>::childIndex(const Inner* inner, const Key& k) const {
+    // the number of separators <= k
+    int low = 0;
+    int high = inner->count;
+    while (low < high) {
+        int mid = (low + high) / 2;
+        if (less(k, inner->keys[mid])) {
+            high = mid;
+        } else {
+            low = mid + 1;
+        }
+    }
+    return low;
+}
+
+template<typename Key, typename Val, typename Less>
+typename BPlusTree<Key, Val, Less>::Leaf* BPlusTree<Key, Val, Less>::findLeaf(const Key& k) const {
+    Node* node = root;
+    while (!node->leaf) {
+        Inner* inner = static_cast<Inner*>(node);
+        node = inner->children[childIndex(inner, k)];
+    }
+    return static_cast<Leaf*>(node);
+}
+
+template<typename Key, typename Val, typename Less>
+Val BPlusTree<Key, Val, Less>::find(const Key& k) const {
+    const Leaf* leaf = findLeaf(k);
+    int pos = lowerBound(leaf->keys, leaf->count, k);
+    if (pos < leaf->count && equal(leaf->keys[pos], k)) {
+        return leaf->vals[pos];
+    }
+    throw std::runtime_error("find: error, key not found");
+}
+
+template<typename Key, typename Val, typename Less>
+void BPlusTree<Key, Val, Less>::insert(const Key& k, const Val& v) {
+    Key splitKey;
+    bool added = false;
+    Node* sibling = insertInto(root, k, v, splitKey, added);
+    if (sibling != nullptr) {
+        // the root split: grow the tree by one level
+        Inner* newRoot = new Inner;
+        newRoot->keys[0] = splitKey;
+        newRoot->children[0] = root;
+        newRoot->children[1] = sibling;
+        newRoot->count = 1;
+        root = newRoot;
+    }
+    if (added) {
+        length++;
+    }
+}
+
+template<typename Key, typename Val, typename Less>
+typename BPlusTree<Key, Val, Less>::Node* BPlusTree<Key, Val, Less>::insertInto(
+    Node* node, const Key& k, const Val& v, Key& splitKey, bool& added) {
+    if (node->leaf) {
+        Leaf* leaf = static_cast<Leaf*>(node);
+        int pos = lowerBound(leaf->keys, leaf->count, k);
+        if (pos < leaf->count && equal(leaf->keys[pos], k)) {
+            // key already exists - update value
+            leaf->vals[pos] = v;
+            return nullptr;
+        }
+        added = true;
+
+        Leaf* target = leaf;
+        Leaf* sibling = nullptr;
+        if (leaf->count == LEAF_CAPACITY) {
+            // split: the upper half moves to a new leaf to the right
+            sibling = new Leaf;
+            int half = LEAF_CAPACITY / 2;
+            for (int i = half; i < LEAF_CAPACITY; i++) {
+                sibling->keys[i - half] = leaf->keys[i];
+                sibling->vals[i - half] = leaf->vals[i];
+            }
+            sibling->count = LEAF_CAPACITY - half;
+            leaf->count = half;
+            sibling->next = leaf->next;
+            sibling->prev = leaf;
+            if (leaf->next != nullptr) {
+                leaf->next->prev = sibling;
+            }
+            leaf->next = sibling;
+            leaves++;
+            leafIndexStale = true;
+            if (pos >= half) {
+                target = sibling;
+                pos -= half;
+            }
+        }
+        for (int i = target->count; i > pos; i--) {
+            target->keys[i] = target->keys[i - 1];
+            target->vals[i] = target->vals[i - 1];
+        }
+        target->keys[pos] = k;
+        target->vals[pos] = v;
+        target->count++;
+        if (sibling != nullptr) {
+            splitKey = sibling->keys[0];
+        }
+        return sibling;
+    }
+
+    Inner* inner = static_cast<Inner*>(node);
+    int ci = childIndex(inner, k);
+    Key childSplitKey;
+    Node* childSibling = insertInto(inner->children[ci], k, v, childSplitKey, added);
+    if (childSibling == nullptr) {
+        return nullptr;
+    }
+
+    if (inner->count < INNER_CAPACITY - 1) {
+        for (int i = inner->count; i > ci; i--) {
+            inner->keys[i] = inner->keys[i - 1];
+            inner->children[i + 1] = inner->children[i];
+        }
+        inner->keys[ci] = childSplitKey;
+        inner->children[ci + 1] = childSibling;
+        inner->count++;
+        return nullptr;
+    }
+
+    // split a full inner node: lay out all keys and children including the new one,
+    // keep the lower half, push the middle key up and move the rest to a new node
+    Key keys[INNER_CAPACITY];
+    Node* children[INNER_CAPACITY + 1];
+    for (int i = 0, j = 0; i < INNER_CAPACITY; i++) {
+        keys[i] = (i == ci) ? childSplitKey : inner->keys[j++];
+    }
+    for (int i = 0, j = 0; i <= INNER_CAPACITY; i++) {
+        children[i] = (i == ci + 1) ? childSibling : inner->children[j++];
+    }
+    int half = INNER_CAPACITY / 2;
+    Inner* sibling = new Inner;
+    inner->count = half;
+    for (int i = 0; i < half; i++) {
+        inner->keys[i] = keys[i];
+        inner->children[i] = children[i];
+    }
+    inner->children[half] = children[half];
+    splitKey = keys[half];
+    sibling->count = INNER_CAPACITY - half - 1;
+    for (int i = 0; i < sibling->count; i++) {
+        sibling->keys[i] = keys[half + 1 + i];
+        sibling->children[i] = children[half + 1 + i];
+    }
+    sibling->children[sibling->count] = children[INNER_CAPACITY];
+    return sibling;
+}
+
+template<typename Key, typename Val, typename Less>
+void BPlusTree<Key, Val, Less>::remove(const Key& k) {
+    if (!removeFrom(root, k)) {
+        throw std::runtime_error("remove: error, key not found");
+    }
+    length--;
+    if (!root->leaf && root->count == 0) {
+        // the root has a single child left: shrink the tree by one level
+        Inner* oldRoot = static_cast<Inner*>(root);
+        root = oldRoot->children[0];
+        delete oldRoot;
+    }
+}
+
+template<typename Key, typename Val, typename Less>
+bool BPlusTree<Key, Val, Less>::removeFrom(Node* node, const Key& k) {
+    if (node->leaf) {
+        Leaf* leaf = static_cast<Leaf*>(node);
+        int pos = lowerBound(leaf->keys, leaf->count, k);
+        if (pos == leaf->count || !equal(leaf->keys[pos], k)) {
+            return false;
+        }
+        for (int i = pos; i < leaf->count - 1; i++) {
+            leaf->keys[i] = leaf->keys[i + 1];
+            leaf->vals[i] = leaf->vals[i + 1];
+        }
+        leaf->count--;
+        return true;
+    }
+
+    Inner* inner = static_cast<Inner*>(node);
+    int ci = childIndex(inner, k);
+    if (!removeFrom(inner->children[ci], k)) {
+        return false;
+    }
+    Node* child = inner->children[ci];
+    if (child->count < (child->leaf ? MIN_LEAF : MIN_INNER)) {
+        rebalance(inner, ci);
+    }
+    return true;
+}
+
+template<typename Key, typename Val, typename Less>
+void BPlusTree<Key, Val, Less>::removeFromInner(Inner* inner, int i) {
+    for (int j = i; j < inner->count - 1; j++) {
+        inner->keys[j] = inner->keys[j + 1];
+        inner->children[j + 1] = inner->children[j + 2];
+    }
+    inner->count--;
+}
+
+template<typename Key, typename Val, typename Less>
+void BPlusTree<Key, Val, Less>::rebalance(Inner* parent, int i) {
+    Node* left = i > 0 ? parent->children[i - 1] : nullptr;
+    Node* right = i < parent->count ? parent->children[i + 1] : nullptr;
+    Node* child = parent->children[i];
+
+    if (child->leaf) {
+        Leaf* leaf = static_cast<Leaf*>(child);
+        Leaf* leftLeaf = static_cast<Leaf*>(left);
+        Leaf* rightLeaf = static_cast<Leaf*>(right);
+        if (leftLeaf != nullptr && leftLeaf->count > MIN_LEAF) {
+            // borrow the largest record of the left sibling
+            for (int j = leaf->count; j > 0; j--) {
+                leaf->keys[j] = leaf->keys[j - 1];
+                leaf->vals[j] = leaf->vals[j - 1];
+            }
+            leftLeaf->count--;
+            leaf->keys[0] = leftLeaf->keys[leftLeaf->count];
+            leaf->vals[0] = leftLeaf->vals[leftLeaf->count];
+            leaf->count++;
+            parent->keys[i - 1] = leaf->keys[0];
+        } else if (rightLeaf != nullptr && rightLeaf->count > MIN_LEAF) {
+            // borrow the smallest record of the right sibling
+            leaf->keys[leaf->count] = rightLeaf->keys[0];
+            leaf->vals[leaf->count] = rightLeaf->vals[0];
+            leaf->count++;
+            for (int j = 0; j < rightLeaf->count - 1; j++) {
+                rightLeaf->keys[j] = rightLeaf->keys[j + 1];
+                rightLeaf->vals[j] = rightLeaf->vals[j + 1];
+            }
+            rightLeaf->count--;
+            parent->keys[i] = rightLeaf->keys[0];
+        } else {
+            // merge with a sibling: the right one of the pair is emptied into the left one
+            Leaf* into = leftLeaf != nullptr ? leftLeaf : leaf;
+            Leaf* from = leftLeaf != nullptr ? leaf : rightLeaf;
+            for (int j = 0; j < from->count; j++) {
+                into->keys[into->count + j] = from->keys[j];
+                into->vals[into->count + j] = from->vals[j];
+            }
+            into->count += from->count;
+            into->next = from->next;
+            if (from->next != nullptr) {
+                from->next->prev = into;
+            }
+            removeFromInner(parent, leftLeaf != nullptr ? i - 1 : i);
+            delete from;
+            leaves--;
+            leafIndexStale = true;
+        }
+        return;
+    }
+
+    Inner* inner = static_cast<Inner*>(child);
+    Inner* leftInner = static_cast<Inner*>(left);
+    Inner* rightInner = static_cast<Inner*>(right);
+    if (leftInner != nullptr && leftInner->count > MIN_INNER) {
+        // rotate right: the separator comes down, the left sibling's last key goes up
+        for (int j = inner->count; j > 0; j--) {
+            inner->keys[j] = inner->keys[j - 1];
+        }
+        for (int j = inner->count + 1; j > 0; j--) {
+            inner->children[j] = inner->children[j - 1];
+        }
+        inner->keys[0] = parent->keys[i - 1];
+        inner->children[0] = leftInner->children[leftInner->count];
+        inner->count++;
+        parent->keys[i - 1] = leftInner->keys[leftInner->count - 1];
+        leftInner->count--;
+    } else if (rightInner != nullptr && rightInner->count > MIN_INNER) {
+        // rotate left: the separator comes down, the right sibling's first key goes up
+        inner->keys[inner->count] = parent->keys[i];
+        inner->children[inner->count + 1] = rightInner->children[0];
+        inner->count++;
+        parent->keys[i] = rightInner->keys[0];
+        for (int j = 0; j < rightInner->count - 1; j++) {
+            rightInner->keys[j] = rightInner->keys[j + 1];
+        }
+        for (int j = 0; j < rightInner->count; j++) {
+            rightInner->children[j] = rightInner->children[j + 1];
+        }
+        rightInner->count--;
+    } else {
+        // merge with a sibling, pulling the separator between them down
+        int separator = leftInner != nullptr ? i - 1 : i;
+        Inner* into = leftInner != nullptr ? leftInner : inner;
+        Inner* from = leftInner != nullptr ? inner : rightInner;
+        into->keys[into->count] = parent->keys[separator];
+        for (int j = 0; j < from->count; j++) {
+            into->keys[into->count + 1 + j] = from->keys[j];
+        }
+        for (int j = 0; j <= from->count; j++) {
+            into->children[into->count + 1 + j] = from->children[j];
+        }
+        into->count += 1 + from->count;
+        removeFromInner(parent, separator);
+        delete from;
+    }
+}
+
+template<typename Key, typename Val, typename Less>
+int BPlusTree<Key, Val, Less>::size() const {
+    return length;
+}
+
+template<typename Key, typename Val, typename Less>
+int BPlusTree<Key, Val, Less>::slotCount() const {
+    return leaves;
+}
+
+template<typename Key, typename Val, typename Less>
+void BPlusTree<Key, Val, Less>::reserve(int) {
+}
+
+template<typename Key, typename Val, typename Less>
+void BPlusTree<Key, Val, Less>::forEachInRange(
+    int begin, int end, const std::function<void(const Key&, const Val&)>& visit) const {
+    begin = std::max(begin, 0);
+    const Leaf* leaf = leafAt(begin);
+    for (int i = begin; i < end && leaf != nullptr; i++, leaf = leaf->next) {
+        for (int j = 0; j < leaf->count; j++) {
+            visit(leaf->keys[j], leaf->vals[j]);
+        }
+    }
+}
+
+template<typename Key, typename Val, typename Less>
+const typename BPlusTree<Key, Val, Less>::Leaf* BPlusTree<Key, Val, Less>::leafAt(int i) const {
+    std::lock_guard<std::mutex> guard(leafIndexLock);
+    if (leafIndexStale) {
+        leafIndex.clear();
+        for (const Leaf* leaf = head; leaf != nullptr; leaf = leaf->next) {
+            leafIndex.push_back(leaf);
+        }
+        leafIndexStale = false;
+    }
+    return i < static_cast<int>(leafIndex.size()) ? leafIndex[i] : nullptr;
+}
+
+template<typename Key, typename Val, typename Less>
+void BPlusTree<Key, Val, Less>::rangeScan(
+    const Key& low, const Key& high, const std::function<void(const Key&, const Val&)>& visit) const {
+    scanFrom(low, [this, &high, &visit](const Key& k, const Val& v) {
+        if (less(high, k)) {
+            return false;
+        }
+        visit(k, v);
+        return true;
+    });
+}
+
+template<typename Key, typename Val, typename Less>
+void BPlusTree<Key, Val, Less>::scanFrom(
+    const Key& low, const std::function<bool(const Key&, const Val&)>& visit) const {
+    const Leaf* leaf = findLeaf(low);
+    int pos = lowerBound(leaf->keys, leaf->count, low);
+    while (leaf != nullptr) {
+        for (int j = pos; j < leaf->count; j++) {
+            if (!visit(leaf->keys[j], leaf->vals[j])) {
+                return;
+            }
+        }
+        leaf = leaf->next;
+        pos = 0;
+    }
+}
+
+template<typename Key, typename Val, typename Less>
+int BPlusTree<Key, Val, Less>::height() const {
+    int levels = 1;
+    for (const Node* node = root; !node->leaf; node = static_cast<const Inner*>(node)->children[0]) {
+        levels++;
+    }
+    return levels;
+}
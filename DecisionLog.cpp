@@ -0,0 +1,169 @@
+#include "DecisionLog.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+    void appendUint32(AsyncLogSink::Producer& out, unsigned int value) {
+        char bytes[4];
+        for (int i = 0; i < 4; i++) {
+            bytes[i] = static_cast<char>((value >> (8 * i)) & 0xff);
+        }
+        out.append(bytes, 4);
+    }
+
+    void appendUint64(AsyncLogSink::Producer& out, unsigned long long value) {
+        char bytes[8];
+        for (int i = 0; i < 8; i++) {
+            bytes[i] = static_cast<char>((value >> (8 * i)) & 0xff);
+        }
+        out.append(bytes, 8);
+    }
+
+    // Reads `n` bytes, returning false at a clean end of input
+    bool readBytes(std::istream& in, unsigned char* bytes, std::size_t n) {
+        in.read(reinterpret_cast<char*>(bytes), static_cast<std::streamsize>(n));
+        if (in.gcount() == 0 && in.eof()) {
+            return false;
+        }
+        if (static_cast<std::size_t>(in.gcount()) != n) {
+            throw std::runtime_error("expandDecisionLog: error, the log is truncated");
+        }
+        return true;
+    }
+
+    unsigned long long readLittleEndian(std::istream& in, int n) {
+        unsigned char bytes[8];
+        if (!readBytes(in, bytes, n)) {
+            throw std::runtime_error("expandDecisionLog: error, the log is truncated");
+        }
+        unsigned long long value = 0;
+        for (int i = n - 1; i >= 0; i--) {
+            value = (value << 8) | bytes[i];
+        }
+        return value;
+    }
+}
+
+// TextDecisionLog
+
+TextDecisionLog::TextDecisionLog(AsyncLogSink& sink) : out(sink) {}
+
+void TextDecisionLog::record(int orderNum, const COVIDTestOrder& order, bool accepted, int total) {
+    const StreetAddress& addr = order.sa;
+    out.append('#');
+    out.append(orderNum);
+    if (accepted) {
+        out.append(" accepted: ");
+    } else {
+        out.append(" rejected: ");
+    }
+    out.append(order.numOrdered);
+    out.append(" kits to ");
+    out.append(addr.number);
+    out.append(' ');
+    out.append(addr.street);
+    out.append(", ");
+    out.append(addr.city);
+    out.append(' ');
+    out.append(addr.zip);
+    out.append(" (");
+    out.append(total);
+    if (accepted) {
+        out.append(" total)\n");
+    } else {
+        out.append(" already)\n");
+    }
+}
+
+// BinaryDecisionLog
+
+BinaryDecisionLog::BinaryDecisionLog(AsyncLogSink& sink)
+    : out(sink), accepted(BLOCK_ORDERS / 64, 0), totals(BLOCK_ORDERS / 2, 0), count(0), firstOrder(1) {
+    out.append("CTDL", 4);
+    appendUint32(out, VERSION);
+}
+
+BinaryDecisionLog::~BinaryDecisionLog() {
+    writeBlock();
+    appendUint32(out, 0);
+}
+
+void BinaryDecisionLog::record(int orderNum, const COVIDTestOrder&, bool accept, int total) {
+    if (total < 0 || total > MAX_TOTAL) {
+        throw std::runtime_error("BinaryDecisionLog: error, total does not fit in 4 bits");
+    }
+    if (count == BLOCK_ORDERS || (count > 0 && orderNum != firstOrder + count)) {
+        writeBlock(); // full, or the order numbers skipped ahead
+    }
+    if (count == 0) {
+        firstOrder = orderNum;
+    }
+    if (accept) {
+        accepted[count / 64] |= 1ULL << (count % 64);
+    }
+    totals[count / 2] |= static_cast<unsigned char>(total << (4 * (count % 2)));
+    count++;
+}
+
+void BinaryDecisionLog::writeBlock() {
+    if (count == 0) {
+        return;
+    }
+    int words = (count + 63) / 64;
+    int bytes = (count + 1) / 2;
+    appendUint32(out, static_cast<unsigned int>(count));
+    appendUint32(out, static_cast<unsigned int>(firstOrder));
+    for (int i = 0; i < words; i++) {
+        appendUint64(out, accepted[i]);
+        accepted[i] = 0;
+    }
+    out.append(reinterpret_cast<const char*>(totals.data()), bytes);
+    std::fill(totals.begin(), totals.begin() + bytes, 0);
+    count = 0;
+}
+
+long long expandDecisionLog(std::istream& in, const std::vector<COVIDTestOrder>& orders, AsyncLogSink& sink) {
+    TextDecisionLog text(sink);
+    long long expanded = 0;
+    std::vector<unsigned char> bits;
+    std::vector<unsigned char> totals;
+
+    unsigned char magic[4];
+    while (readBytes(in, magic, 4)) {
+        if (magic[0] != 'C' || magic[1] != 'T' || magic[2] != 'D' || magic[3] != 'L') {
+            throw std::runtime_error("expandDecisionLog: error, not a decision log");
+        }
+        if (readLittleEndian(in, 4) != BinaryDecisionLog::VERSION) {
+            throw std::runtime_error("expandDecisionLog: error, unsupported decision log version");
+        }
+        // blocks until the run trailer
+        while (true) {
+            long long count = static_cast<long long>(readLittleEndian(in, 4));
+            if (count == 0) {
+                break;
+            }
+            if (count > BinaryDecisionLog::BLOCK_ORDERS) {
+                throw std::runtime_error("expandDecisionLog: error, block is too large");
+            }
+            long long firstOrder = static_cast<long long>(readLittleEndian(in, 4));
+            bits.resize(((count + 63) / 64) * 8);
+            totals.resize((count + 1) / 2);
+            // a block cut off after its header is as truncated as one cut off inside it
+            if (!readBytes(in, bits.data(), bits.size()) || !readBytes(in, totals.data(), totals.size())) {
+                throw std::runtime_error("expandDecisionLog: error, the log is truncated");
+            }
+
+            if (firstOrder < 1 || firstOrder + count - 1 > static_cast<long long>(orders.size())) {
+                throw std::runtime_error("expandDecisionLog: error, the log has more orders than the order file");
+            }
+            for (long long i = 0; i < count; i++) {
+                bool accept = (bits[i / 8] >> (i % 8)) & 1; // little-endian words: bit i is in byte i / 8
+                int total = (totals[i / 2] >> (4 * (i % 2))) & 0xf;
+                int orderNum = static_cast<int>(firstOrder + i);
+                text.record(orderNum, orders[orderNum - 1], accept, total);
+                expanded++;
+            }
+        }
+    }
+    return expanded;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "AsyncLogSink.hpp"
+#include "COVIDTestOrder.hpp"
+#include <istream>
+#include <string>
+#include <vector>
+
+// Where runSimulator reports the outcome of every order in analyze mode.
+// One DecisionLog covers one simulation run, on one thread.
+class DecisionLog {
+public:
+    DecisionLog() {}
+    virtual ~DecisionLog() {}
+
+    // Records the decision for order number `orderNum` (counting from 1):
+    // `total` is the household's new total if accepted, or what it already had if rejected
+    virtual void record(int orderNum, const COVIDTestOrder& order, bool accepted, int total) = 0;
+};
+
+// Writes each decision as one line of text:
+// "#12 accepted: 2 kits to 948 Cliff Ln, Union City 95533 (4 total)"
+class TextDecisionLog : public DecisionLog {
+private:
+    AsyncLogSink::Producer out;
+
+public:
+    explicit TextDecisionLog(AsyncLogSink& sink);
+
+    virtual void record(int orderNum, const COVIDTestOrder& order, bool accepted, int total) override;
+};
+
+// Writes decisions in a compact binary layout, well under a byte per order.
+// The addresses and kit counts aren't stored: expanding the log back into text
+// needs the same orders the simulation ran on (see expandDecisionLog).
+//
+// Layout, all integers little-endian:
+//   run header:  "CTDL", uint32 version
+//   blocks:      uint32 count (1 .. BLOCK_ORDERS), uint32 number of the block's first order,
+//                accepted bitset: ceil(count / 64) uint64 words, bit i of word w is order 64 * w + i,
+//                totals column:   ceil(count / 2) bytes, two 4-bit totals per byte, low nibble first
+//   run trailer: uint32 0
+class BinaryDecisionLog : public DecisionLog {
+public:
+    static const int BLOCK_ORDERS = 65536; // orders per block
+    static const int MAX_TOTAL = 15;       // the largest total a 4-bit column entry holds
+    static const unsigned int VERSION = 1;
+
+private:
+    AsyncLogSink::Producer out;
+    std::vector<unsigned long long> accepted; // the current block's bitset
+    std::vector<unsigned char> totals;        // the current block's totals column
+    int count;                                // orders in the current block
+    int firstOrder;                           // order number of the block's first order
+
+    // Writes the current block and starts an empty one
+    void writeBlock();
+
+public:
+    explicit BinaryDecisionLog(AsyncLogSink& sink);
+
+    // Writes the last block and the run trailer
+    virtual ~BinaryDecisionLog();
+
+    // Throws a runtime_error if `total` doesn't fit in 4 bits
+    virtual void record(int orderNum, const COVIDTestOrder& order, bool accepted, int total) override;
+};
+
+// Reads every run in a binary decision log and writes it to `out` as a text log,
+// looking up each order number in `orders` (the orders the runs were simulated on).
+// Returns the number of decisions expanded.
+// Throws a runtime_error if the log is malformed or refers to an order that isn't in `orders`.
+long long expandDecisionLog(std::istream& in, const std::vector<COVIDTestOrder>& orders, AsyncLogSink& out);
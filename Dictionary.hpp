@@ -1,5 +1,7 @@
 #pragma once
 
+#include <functional>
+
 template<typename Key, typename Val>
 class Dictionary {
 public:
@@ -24,4 +26,21 @@ public:
 
     // Return the number of records in the dictionary
     virtual int size() const = 0;
+
+    // Return the number of storage positions forEachInRange covers: hash slots or buckets (some
+    // of them empty), tree leaves, or the array slots that hold records (arrays keep them packed)
+    virtual int slotCount() const = 0;
+
+    // Grow to at least `capacity` storage positions (what the constructor's size counts), keeping
+    // every record; never shrinks. Structures that grow on their own treat it as a no-op.
+    virtual void reserve(int capacity) = 0;
+
+    // Call visit(key, value) for every record stored in positions [begin, end), in storage order.
+    // Splitting 0 .. slotCount() into ranges lets several threads scan one dictionary.
+    virtual void forEachInRange(int begin, int end, const std::function<void(const Key&, const Val&)>& visit) const = 0;
+
+    // Call visit(key, value) for every record in the dictionary
+    void forEach(const std::function<void(const Key&, const Val&)>& visit) const {
+        forEachInRange(0, slotCount(), visit);
+    }
 };
\ No newline at end of file
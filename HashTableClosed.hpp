@@ -2,11 +2,22 @@
 
 #include "Dictionary.hpp"
 #include "hashing.hpp"
+#include "HashTableStats.hpp"
+#include "LinearProbing.hpp"
 #include <stdexcept>
 #include <iostream>
+#include <memory>
+#include <utility>
 
-template<typename Key, typename Val>
+// `Allocator` supplies the record and flag arrays (rebound to their types); see HugePageAllocator
+template<typename Key, typename Val, typename Allocator = std::allocator<std::pair<const Key, Val>>>
 class HashTableClosed : public Dictionary<Key, Val> {
+public:
+    // An enum to denote the state of a slot in the hash table
+    enum class SlotType {
+        EMPTY, TOMBSTONE, RECORD,
+    };
+
 protected:
     // an element in the dictionary, contains a key and a value
     struct Record {
@@ -17,25 +28,43 @@ protected:
         Record(Key x, Val y) : k(x), v(y) {}
     };
 
-    // An enum to denote the state of a slot in the hash table
-    enum class SlotType {
-        EMPTY, TOMBSTONE, RECORD,
-    };
+    typedef typename std::allocator_traits<Allocator>::template rebind_alloc<Record> RecordAllocator;
+    typedef typename std::allocator_traits<Allocator>::template rebind_alloc<SlotType> FlagAllocator;
 
+    RecordAllocator recordAllocator;
+    FlagAllocator flagAllocator;
     int M;                 // size of the hash table
     Record* ht;            // array to store records
     SlotType* flags;       // parallel array for slot status
     int probe_constant;    // linear probing constant
     int length;            // number of elements
 
-    // Linear probing function
-    int probe(int i) const {
-        return probe_constant * i;
+    bool counting;                   // whether probe counters are being updated
+    mutable ProbeCounters counters;  // probes done by find/insert/remove while counting
+
+    // Adds one operation that looked at `probes` slots to the counters
+    void tally(long long& ops, long long& total, int probes) const {
+        if (counting) {
+            ops++;
+            total += probes;
+        }
+    }
+
+    // Walks the probe sequence of a key (see LinearProbing.hpp)
+    cs20::ProbeResult probeFor(const Key& k) const {
+        return cs20::linearProbe(cs20::hash(k), probe_constant, M,
+            [this](int slot) { return flags[slot] == SlotType::EMPTY; },
+            [this](int slot) { return flags[slot] == SlotType::TOMBSTONE; },
+            [this, &k](int slot) { return ht[slot].k == k; });
     }
 
 public:
     // constructor
-    HashTableClosed(int maxSize = 100, int probeSkipNum = 1);
+    HashTableClosed(int maxSize = 100, int probeSkipNum = 1, const Allocator& allocator = Allocator());
+
+    // the arrays belong to the table, so it can't be copied
+    HashTableClosed(const HashTableClosed&) = delete;
+    HashTableClosed& operator=(const HashTableClosed&) = delete;
 
     // destructor
     virtual ~HashTableClosed();
@@ -46,6 +75,26 @@ public:
     virtual void insert(const Key&, const Val&) override;
     virtual void remove(const Key&) override;
     virtual int size() const override;
+    virtual int slotCount() const override;
+    virtual void reserve(int capacity) override; // rehashes into `capacity` slots, dropping tombstones
+    virtual void forEachInRange(int begin, int end,
+                                const std::function<void(const Key&, const Val&)>& visit) const override;
+
+    // read-only access to the raw slots, for code that lays the table out elsewhere
+    // (see MappedHashTable); keyAt/valueAt are only meaningful for RECORD slots
+    int capacity() const;
+    int probeSkip() const;
+    SlotType slotType(int slot) const;
+    const Key& keyAt(int slot) const;
+    const Val& valueAt(int slot) const;
+
+    // health statistics: one pass over the slots
+    HashTableStats stats() const;
+
+    // turn probe counting on or off, read it back, and reset it
+    void countProbes(bool enable);
+    const ProbeCounters& probeCounters() const;
+    void resetProbeCounters();
 
     // for testing purposes
     void print() const;
@@ -53,111 +102,214 @@ public:
 
 // implementation
 
-template<typename Key, typename Val>
-HashTableClosed<Key, Val>::HashTableClosed(int maxSize, int probeSkipNum)
-    : M(maxSize), probe_constant(probeSkipNum), length(0) {
-    ht = new Record[M];
-    flags = new SlotType[M];
+template<typename Key, typename Val, typename Allocator>
+HashTableClosed<Key, Val, Allocator>::HashTableClosed(int maxSize, int probeSkipNum, const Allocator& allocator)
+    : recordAllocator(allocator), flagAllocator(allocator), M(maxSize), probe_constant(probeSkipNum),
+      length(0), counting(false) {
+    ht = std::allocator_traits<RecordAllocator>::allocate(recordAllocator, M);
+    flags = std::allocator_traits<FlagAllocator>::allocate(flagAllocator, M);
     for (int i = 0; i < M; i++) {
+        std::allocator_traits<RecordAllocator>::construct(recordAllocator, ht + i);
         flags[i] = SlotType::EMPTY;
     }
 }
 
-template<typename Key, typename Val>
-HashTableClosed<Key, Val>::~HashTableClosed() {
-    delete[] ht;
-    delete[] flags;
+template<typename Key, typename Val, typename Allocator>
+HashTableClosed<Key, Val, Allocator>::~HashTableClosed() {
+    for (int i = 0; i < M; i++) {
+        std::allocator_traits<RecordAllocator>::destroy(recordAllocator, ht + i);
+    }
+    std::allocator_traits<RecordAllocator>::deallocate(recordAllocator, ht, M);
+    std::allocator_traits<FlagAllocator>::deallocate(flagAllocator, flags, M);
 }
 
-template<typename Key, typename Val>
-void HashTableClosed<Key, Val>::clear() {
+template<typename Key, typename Val, typename Allocator>
+void HashTableClosed<Key, Val, Allocator>::clear() {
+    // the records stay allocated; marking every slot empty is enough for them to be overwritten
     length = 0;
-    delete[] ht;
-    ht = new Record[M];
     for (int i = 0; i < M; i++) {
         flags[i] = SlotType::EMPTY;
     }
 }
 
-template<typename Key, typename Val>
-Val HashTableClosed<Key, Val>::find(const Key& k) const {
-    int hashValue = cs20::hash(k);
-    for (int i = 0; i < M; i++) {
-        int index = (hashValue + probe(i)) % M;
-        if (index < 0) {
-            index += M; // adjust for negative index
-        }
-        if (flags[index] == SlotType::EMPTY) {
-            break;  // key not found
-        }
-        if (flags[index] == SlotType::RECORD && ht[index].k == k) {
-            return ht[index].v;
-        }
+template<typename Key, typename Val, typename Allocator>
+Val HashTableClosed<Key, Val, Allocator>::find(const Key& k) const {
+    cs20::ProbeResult result = probeFor(k);
+    tally(counters.finds, counters.findProbes, result.probes);
+    if (result.found == -1) {
+        throw std::runtime_error("find: error, key not found");
     }
-    throw std::runtime_error("find: error, key not found");
+    return ht[result.found].v;
 }
 
-template<typename Key, typename Val>
-void HashTableClosed<Key, Val>::insert(const Key& k, const Val& v) {
+template<typename Key, typename Val, typename Allocator>
+void HashTableClosed<Key, Val, Allocator>::insert(const Key& k, const Val& v) {
     if (length >= M) {
         throw std::runtime_error("insert: error, the hash table is full");
     }
 
-    int hashValue = cs20::hash(k);
-    int first_tombstone = -1;
+    cs20::ProbeResult result = probeFor(k);
+    tally(counters.inserts, counters.insertProbes, result.probes);
+    if (result.found != -1) {
+        // key already exists - update value
+        ht[result.found].v = v;
+        return;
+    }
+    if (result.insertAt == -1) {
+        throw std::runtime_error("insert: error, the hash table is full");
+    }
+    // the first tombstone on the way, or the empty slot that ended the search
+    ht[result.insertAt] = Record(k, v);
+    flags[result.insertAt] = SlotType::RECORD;
+    length++;
+}
+
+template<typename Key, typename Val, typename Allocator>
+void HashTableClosed<Key, Val, Allocator>::remove(const Key& k) {
+    cs20::ProbeResult result = probeFor(k);
+    tally(counters.removes, counters.removeProbes, result.probes);
+    if (result.found == -1) {
+        throw std::runtime_error("remove: error, key not found");
+    }
+    flags[result.found] = SlotType::TOMBSTONE;
+    length--;
+}
+
+template<typename Key, typename Val, typename Allocator>
+int HashTableClosed<Key, Val, Allocator>::size() const {
+    return length;
+}
+
+template<typename Key, typename Val, typename Allocator>
+int HashTableClosed<Key, Val, Allocator>::slotCount() const {
+    return M;
+}
+
+template<typename Key, typename Val, typename Allocator>
+void HashTableClosed<Key, Val, Allocator>::reserve(int capacity) {
+    if (capacity <= M) {
+        return;
+    }
+    Record* newHt = std::allocator_traits<RecordAllocator>::allocate(recordAllocator, capacity);
+    SlotType* newFlags = std::allocator_traits<FlagAllocator>::allocate(flagAllocator, capacity);
+    for (int i = 0; i < capacity; i++) {
+        std::allocator_traits<RecordAllocator>::construct(recordAllocator, newHt + i);
+        newFlags[i] = SlotType::EMPTY;
+    }
+
+    // the keys are distinct, so each record goes in the first empty slot of its new probe sequence
+    for (int slot = 0; slot < M; slot++) {
+        if (flags[slot] != SlotType::RECORD) {
+            continue;
+        }
+        cs20::ProbeResult result = cs20::linearProbe(cs20::hash(ht[slot].k), probe_constant, capacity,
+            [newFlags](int i) { return newFlags[i] == SlotType::EMPTY; },
+            [](int) { return false; },
+            [](int) { return false; });
+        newHt[result.insertAt] = ht[slot];
+        newFlags[result.insertAt] = SlotType::RECORD;
+    }
+
     for (int i = 0; i < M; i++) {
-        int index = (hashValue + probe(i)) % M;
-        if (index < 0) {
-            index += M; // adjust for negative index
+        std::allocator_traits<RecordAllocator>::destroy(recordAllocator, ht + i);
+    }
+    std::allocator_traits<RecordAllocator>::deallocate(recordAllocator, ht, M);
+    std::allocator_traits<FlagAllocator>::deallocate(flagAllocator, flags, M);
+    ht = newHt;
+    flags = newFlags;
+    M = capacity;
+}
+
+template<typename Key, typename Val, typename Allocator>
+void HashTableClosed<Key, Val, Allocator>::forEachInRange(
+    int begin, int end, const std::function<void(const Key&, const Val&)>& visit) const {
+    for (int i = begin; i < end && i < M; i++) {
+        if (flags[i] == SlotType::RECORD) {
+            visit(ht[i].k, ht[i].v);
         }
-        if (flags[index] == SlotType::EMPTY) {
-            if (first_tombstone != -1) {
-                index = first_tombstone;
+    }
+}
+
+template<typename Key, typename Val, typename Allocator>
+int HashTableClosed<Key, Val, Allocator>::capacity() const {
+    return M;
+}
+
+template<typename Key, typename Val, typename Allocator>
+int HashTableClosed<Key, Val, Allocator>::probeSkip() const {
+    return probe_constant;
+}
+
+template<typename Key, typename Val, typename Allocator>
+typename HashTableClosed<Key, Val, Allocator>::SlotType HashTableClosed<Key, Val, Allocator>::slotType(int slot) const {
+    return flags[slot];
+}
+
+template<typename Key, typename Val, typename Allocator>
+const Key& HashTableClosed<Key, Val, Allocator>::keyAt(int slot) const {
+    return ht[slot].k;
+}
+
+template<typename Key, typename Val, typename Allocator>
+const Val& HashTableClosed<Key, Val, Allocator>::valueAt(int slot) const {
+    return ht[slot].v;
+}
+
+template<typename Key, typename Val, typename Allocator>
+HashTableStats HashTableClosed<Key, Val, Allocator>::stats() const {
+    HashTableStats s;
+    s.capacity = M;
+    s.records = length;
+    s.bytesUsed = sizeof(*this) + static_cast<std::size_t>(M) * (sizeof(Record) + sizeof(SlotType));
+
+    long long totalProbes = 0;
+    for (int slot = 0; slot < M; slot++) {
+        if (flags[slot] == SlotType::TOMBSTONE) {
+            s.tombstones++;
+        } else if (flags[slot] == SlotType::RECORD) {
+            // count how far along its probe sequence this record ended up
+            int hashValue = cs20::hash(ht[slot].k);
+            int probes = 1;
+            while (probes <= M && cs20::probeSlot(hashValue, probes - 1, probe_constant, M) != slot) {
+                probes++;
+            }
+            if (static_cast<int>(s.probeLengths.size()) <= probes) {
+                s.probeLengths.resize(probes + 1, 0);
             }
-            ht[index] = Record(k, v);
-            flags[index] = SlotType::RECORD;
-            length++;
-            return;
-        } else if (flags[index] == SlotType::TOMBSTONE) {
-            if (first_tombstone == -1) {
-                first_tombstone = index;
+            s.probeLengths[probes]++;
+            totalProbes += probes;
+            if (probes > s.maxProbeLength) {
+                s.maxProbeLength = probes;
             }
-        } else if (flags[index] == SlotType::RECORD && ht[index].k == k) {
-            // key already exists - update value
-            ht[index].v = v;
-            return;
         }
     }
-    throw std::runtime_error("insert: error, the hash table is full");
+    if (M > 0) {
+        s.loadFactor = static_cast<double>(length) / M;
+        s.tombstoneRatio = static_cast<double>(s.tombstones) / M;
+    }
+    if (length > 0) {
+        s.averageProbeLength = static_cast<double>(totalProbes) / length;
+    }
+    return s;
 }
 
-template<typename Key, typename Val>
-void HashTableClosed<Key, Val>::remove(const Key& k) {
-    int hashValue = cs20::hash(k);
-    for (int i = 0; i < M; i++) {
-        int index = (hashValue + probe(i)) % M;
-        if (index < 0) {
-            index += M; // adjust for negative index
-        }
-        if (flags[index] == SlotType::EMPTY) {
-            break;  // key not found
-        }
-        if (flags[index] == SlotType::RECORD && ht[index].k == k) {
-            flags[index] = SlotType::TOMBSTONE;
-            length--;
-            return;
-        }
-    }
-    throw std::runtime_error("remove: error, key not found");
+template<typename Key, typename Val, typename Allocator>
+void HashTableClosed<Key, Val, Allocator>::countProbes(bool enable) {
+    counting = enable;
 }
 
-template<typename Key, typename Val>
-int HashTableClosed<Key, Val>::size() const {
-    return length;
+template<typename Key, typename Val, typename Allocator>
+const ProbeCounters& HashTableClosed<Key, Val, Allocator>::probeCounters() const {
+    return counters;
+}
+
+template<typename Key, typename Val, typename Allocator>
+void HashTableClosed<Key, Val, Allocator>::resetProbeCounters() {
+    counters = ProbeCounters();
 }
 
-template<typename Key, typename Val>
-void HashTableClosed<Key, Val>::print() const {
+template<typename Key, typename Val, typename Allocator>
+void HashTableClosed<Key, Val, Allocator>::print() const {
     for (int i = 0; i < M; i++) {
         std::cout << i << " ";
         switch (flags[i]) {
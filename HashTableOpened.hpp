@@ -2,10 +2,14 @@
 
 #include "Dictionary.hpp"
 #include "hashing.hpp"
+#include "HashTableStats.hpp"
 #include <stdexcept>
 #include <iostream>
+#include <memory>
+#include <utility>
 
-template<typename Key, typename Val>
+// `Allocator` supplies the bucket array and the nodes (rebound to their types); see HugePageAllocator
+template<typename Key, typename Val, typename Allocator = std::allocator<std::pair<const Key, Val>>>
 class HashTableOpened : public Dictionary<Key, Val> {
 protected:
     // an element in the dictionary, contain a key and a value
@@ -25,15 +29,40 @@ protected:
         Node(const Record& r, Node* n = nullptr) : data(r), next(n) {}
     };
 
+    typedef typename std::allocator_traits<Allocator>::template rebind_alloc<Node> NodeAllocator;
+    typedef typename std::allocator_traits<Allocator>::template rebind_alloc<Node*> BucketAllocator;
+
+    NodeAllocator nodeAllocator;
+    BucketAllocator bucketAllocator;
     int M;         // size of hash table (number of buckets)
     Node** table;  // array of pointers to linked lists (buckets)
     // the double pointer Node** table is for makin an array of pointers, and each pointer Node*
     // is the start of a linked list (bucket) in the hash table. it's used to handle collisions by chaining.
     int length;    // number of elements in hash table
 
+    bool counting;                   // whether probe counters are being updated
+    mutable ProbeCounters counters;  // nodes visited by find/insert/remove while counting
+
+    void freeNode(Node* node) {
+        std::allocator_traits<NodeAllocator>::destroy(nodeAllocator, node);
+        std::allocator_traits<NodeAllocator>::deallocate(nodeAllocator, node, 1);
+    }
+
+    // Adds one operation that looked at `probes` nodes to the counters
+    void tally(long long& ops, long long& total, int probes) const {
+        if (counting) {
+            ops++;
+            total += probes;
+        }
+    }
+
 public:
     // constructor
-    HashTableOpened(int maxSize = 100);
+    HashTableOpened(int maxSize = 100, const Allocator& allocator = Allocator());
+
+    // the nodes belong to the table, so it can't be copied
+    HashTableOpened(const HashTableOpened&) = delete;
+    HashTableOpened& operator=(const HashTableOpened&) = delete;
 
     // destructor
     virtual ~HashTableOpened();
@@ -44,6 +73,18 @@ public:
     virtual void insert(const Key&, const Val&) override;
     virtual void remove(const Key&) override;
     virtual int size() const override;
+    virtual int slotCount() const override;
+    virtual void reserve(int capacity) override; // relinks the existing nodes into `capacity` buckets
+    virtual void forEachInRange(int begin, int end,
+                                const std::function<void(const Key&, const Val&)>& visit) const override;
+
+    // health statistics: one pass over the buckets
+    HashTableStats stats() const;
+
+    // turn probe counting on or off, read it back, and reset it
+    void countProbes(bool enable);
+    const ProbeCounters& probeCounters() const;
+    void resetProbeCounters();
 
     // for testing purpose
     void print() const;
@@ -51,82 +92,92 @@ public:
 
 // implementation
 
-template<typename Key, typename Val>
-HashTableOpened<Key, Val>::HashTableOpened(int maxSize)
-    : M(maxSize), length(0) {
+template<typename Key, typename Val, typename Allocator>
+HashTableOpened<Key, Val, Allocator>::HashTableOpened(int maxSize, const Allocator& allocator)
+    : nodeAllocator(allocator), bucketAllocator(allocator), M(maxSize), length(0), counting(false) {
     // initialize table with null pointer
-    table = new Node*[M];
+    table = std::allocator_traits<BucketAllocator>::allocate(bucketAllocator, M);
     for (int i = 0; i < M; ++i) {
         table[i] = nullptr;
     }
 }
 
-template<typename Key, typename Val>
-HashTableOpened<Key, Val>::~HashTableOpened() {
+template<typename Key, typename Val, typename Allocator>
+HashTableOpened<Key, Val, Allocator>::~HashTableOpened() {
     clear();
-    delete[] table;
+    std::allocator_traits<BucketAllocator>::deallocate(bucketAllocator, table, M);
 }
 
-template<typename Key, typename Val>
-void HashTableOpened<Key, Val>::clear() {
+template<typename Key, typename Val, typename Allocator>
+void HashTableOpened<Key, Val, Allocator>::clear() {
     // iterate over each bucket and delete the linked lists
     for (int i = 0; i < M; ++i) {
         Node* current = table[i];
         while (current != nullptr) {
             Node* temp = current;
             current = current->next;
-            delete temp;
+            freeNode(temp);
         }
         table[i] = nullptr;
     }
     length = 0;
 }
 
-template<typename Key, typename Val>
-Val HashTableOpened<Key, Val>::find(const Key& k) const {
+template<typename Key, typename Val, typename Allocator>
+Val HashTableOpened<Key, Val, Allocator>::find(const Key& k) const {
     int hashValue = cs20::hash(k) % M;
     if (hashValue < 0) {
         hashValue += M; // adjust for negative hash values
     }
     Node* current = table[hashValue];
+    int probes = 1; // reaching the end of the chain counts as a probe, like an empty slot does
     while (current != nullptr) {
         if (current->data.k == k) {
+            tally(counters.finds, counters.findProbes, probes);
             return current->data.v;
         }
         current = current->next;
+        probes++;
     }
+    tally(counters.finds, counters.findProbes, probes);
     throw std::runtime_error("find: error, key not found");
 }
 
-template<typename Key, typename Val>
-void HashTableOpened<Key, Val>::insert(const Key& k, const Val& v) {
+template<typename Key, typename Val, typename Allocator>
+void HashTableOpened<Key, Val, Allocator>::insert(const Key& k, const Val& v) {
     int hashValue = cs20::hash(k) % M;
     if (hashValue < 0) {
         hashValue += M; // adjust for negative hash values
     }
     Node* current = table[hashValue];
+    int probes = 1;
     while (current != nullptr) {
         if (current->data.k == k) {
             // key exists - update value
             current->data.v = v;
+            tally(counters.inserts, counters.insertProbes, probes);
             return;
         }
         current = current->next;
+        probes++;
     }
+    tally(counters.inserts, counters.insertProbes, probes);
     // key not found - insert new record at the begining
-    Node* newNode = new Node(Record(k, v), table[hashValue]);
+    Node* newNode = std::allocator_traits<NodeAllocator>::allocate(nodeAllocator, 1);
+    std::allocator_traits<NodeAllocator>::construct(nodeAllocator, newNode, Record(k, v), table[hashValue]);
     table[hashValue] = newNode;
     length++;
 }
 
-template<typename Key, typename Val>
-void HashTableOpened<Key, Val>::remove(const Key& k) {
+template<typename Key, typename Val, typename Allocator>
+void HashTableOpened<Key, Val, Allocator>::remove(const Key& k) {
     int hashValue = cs20::hash(k) % M;
     if (hashValue < 0) {
         hashValue += M; // adjust for negative hash values
     }
     Node* current = table[hashValue];
     Node* prev = nullptr;
+    int probes = 1;
     while (current != nullptr) {
         if (current->data.k == k) {
             // key found - remove node
@@ -136,23 +187,121 @@ void HashTableOpened<Key, Val>::remove(const Key& k) {
             } else {
                 prev->next = current->next;
             }
-            delete current;
+            freeNode(current);
             length--;
+            tally(counters.removes, counters.removeProbes, probes);
             return;
         }
         prev = current;
         current = current->next;
+        probes++;
     }
+    tally(counters.removes, counters.removeProbes, probes);
     throw std::runtime_error("remove: error, key not found");
 }
 
-template<typename Key, typename Val>
-int HashTableOpened<Key, Val>::size() const {
+template<typename Key, typename Val, typename Allocator>
+int HashTableOpened<Key, Val, Allocator>::size() const {
     return length;
 }
 
-template<typename Key, typename Val>
-void HashTableOpened<Key, Val>::print() const {
+template<typename Key, typename Val, typename Allocator>
+int HashTableOpened<Key, Val, Allocator>::slotCount() const {
+    return M;
+}
+
+template<typename Key, typename Val, typename Allocator>
+void HashTableOpened<Key, Val, Allocator>::reserve(int capacity) {
+    if (capacity <= M) {
+        return;
+    }
+    Node** newTable = std::allocator_traits<BucketAllocator>::allocate(bucketAllocator, capacity);
+    for (int i = 0; i < capacity; ++i) {
+        newTable[i] = nullptr;
+    }
+    // move every node to the front of its new bucket; nothing is copied or reallocated
+    for (int i = 0; i < M; ++i) {
+        Node* current = table[i];
+        while (current != nullptr) {
+            Node* next = current->next;
+            int hashValue = cs20::hash(current->data.k) % capacity;
+            if (hashValue < 0) {
+                hashValue += capacity; // adjust for negative hash values
+            }
+            current->next = newTable[hashValue];
+            newTable[hashValue] = current;
+            current = next;
+        }
+    }
+    std::allocator_traits<BucketAllocator>::deallocate(bucketAllocator, table, M);
+    table = newTable;
+    M = capacity;
+}
+
+template<typename Key, typename Val, typename Allocator>
+void HashTableOpened<Key, Val, Allocator>::forEachInRange(
+    int begin, int end, const std::function<void(const Key&, const Val&)>& visit) const {
+    for (int i = begin; i < end && i < M; ++i) {
+        for (Node* current = table[i]; current != nullptr; current = current->next) {
+            visit(current->data.k, current->data.v);
+        }
+    }
+}
+
+template<typename Key, typename Val, typename Allocator>
+HashTableStats HashTableOpened<Key, Val, Allocator>::stats() const {
+    HashTableStats s;
+    s.capacity = M;
+    s.records = length;
+    s.bytesUsed = sizeof(*this) + static_cast<std::size_t>(M) * sizeof(Node*)
+                + static_cast<std::size_t>(length) * sizeof(Node);
+
+    long long totalProbes = 0;
+    for (int i = 0; i < M; ++i) {
+        // the n-th node of a chain takes n probes to find
+        int chain = 0;
+        for (Node* current = table[i]; current != nullptr; current = current->next) {
+            chain++;
+            if (static_cast<int>(s.probeLengths.size()) <= chain) {
+                s.probeLengths.resize(chain + 1, 0);
+            }
+            s.probeLengths[chain]++;
+            totalProbes += chain;
+        }
+        if (static_cast<int>(s.chainLengths.size()) <= chain) {
+            s.chainLengths.resize(chain + 1, 0);
+        }
+        s.chainLengths[chain]++;
+        if (chain > s.maxProbeLength) {
+            s.maxProbeLength = chain;
+        }
+    }
+    if (M > 0) {
+        s.loadFactor = static_cast<double>(length) / M;
+    }
+    if (length > 0) {
+        s.averageProbeLength = static_cast<double>(totalProbes) / length;
+    }
+    return s;
+}
+
+template<typename Key, typename Val, typename Allocator>
+void HashTableOpened<Key, Val, Allocator>::countProbes(bool enable) {
+    counting = enable;
+}
+
+template<typename Key, typename Val, typename Allocator>
+const ProbeCounters& HashTableOpened<Key, Val, Allocator>::probeCounters() const {
+    return counters;
+}
+
+template<typename Key, typename Val, typename Allocator>
+void HashTableOpened<Key, Val, Allocator>::resetProbeCounters() {
+    counters = ProbeCounters();
+}
+
+template<typename Key, typename Val, typename Allocator>
+void HashTableOpened<Key, Val, Allocator>::print() const {
     for (int i = 0; i < M; ++i) {
         std::cout << "bucket " << i << ": ";
         Node* current = table[i];
@@ -0,0 +1,51 @@
+#include "HashTableStats.hpp"
+
+namespace {
+    // lengths above this are printed as one "longer" bin, so degenerate tables stay readable
+    const std::size_t MAX_PRINTED_LENGTH = 32;
+
+    void printHistogram(std::ostream& out, const std::vector<int>& histogram) {
+        long long longer = 0;
+        for (std::size_t i = 0; i < histogram.size(); i++) {
+            if (i > MAX_PRINTED_LENGTH) {
+                longer += histogram[i];
+            } else if (histogram[i] != 0) {
+                out << " " << i << ":" << histogram[i];
+            }
+        }
+        if (longer != 0) {
+            out << " >" << MAX_PRINTED_LENGTH << ":" << longer;
+        }
+    }
+
+    double average(long long probes, long long ops) {
+        return ops == 0 ? 0 : static_cast<double>(probes) / ops;
+    }
+}
+
+HashTableStats::HashTableStats()
+    : capacity(0), records(0), tombstones(0), loadFactor(0), tombstoneRatio(0),
+      maxProbeLength(0), averageProbeLength(0), bytesUsed(0) {}
+
+void HashTableStats::print(std::ostream& out) const {
+    out << "capacity=" << capacity << " records=" << records
+        << " load=" << loadFactor << " tombstones=" << tombstones
+        << " (" << tombstoneRatio << ") bytes=" << bytesUsed << std::endl;
+    out << "probe lengths: max=" << maxProbeLength << " avg=" << averageProbeLength;
+    printHistogram(out, probeLengths);
+    out << std::endl;
+    if (!chainLengths.empty()) {
+        out << "chain lengths:";
+        printHistogram(out, chainLengths);
+        out << std::endl;
+    }
+}
+
+ProbeCounters::ProbeCounters()
+    : finds(0), findProbes(0), inserts(0), insertProbes(0), removes(0), removeProbes(0) {}
+
+void ProbeCounters::print(std::ostream& out) const {
+    out << "probes per op: find=" << average(findProbes, finds) << " (" << finds << " calls)"
+        << " insert=" << average(insertProbes, inserts) << " (" << inserts << " calls)"
+        << " remove=" << average(removeProbes, removes) << " (" << removes << " calls)" << std::endl;
+}
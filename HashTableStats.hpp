@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+#include <vector>
+
+// A snapshot of how healthy a hash table is, computed by walking its slots once
+struct HashTableStats {
+    int capacity;                // number of slots (open addressing) or buckets (chaining)
+    int records;                 // number of live records
+    int tombstones;              // removed slots still in the probe sequences (always 0 for chaining)
+    double loadFactor;           // records / capacity
+    double tombstoneRatio;       // tombstones / capacity
+    int maxProbeLength;          // most probes a successful find needs
+    double averageProbeLength;   // probes an average successful find needs
+    std::vector<int> probeLengths; // probeLengths[i] = how many records take i probes to find
+    std::vector<int> chainLengths; // chaining only: chainLengths[i] = how many buckets hold i records
+    std::size_t bytesUsed;       // memory held by the table itself (not memory owned by the keys/values)
+
+    HashTableStats();
+
+    // Prints the numbers above, one histogram per line
+    void print(std::ostream& out) const;
+};
+
+// Running totals of how many slots/nodes the table looked at while serving requests.
+// Only updated while counting is switched on (see countProbes() on the tables).
+struct ProbeCounters {
+    long long finds;
+    long long findProbes;
+    long long inserts;
+    long long insertProbes;
+    long long removes;
+    long long removeProbes;
+
+    ProbeCounters();
+
+    // Prints the average probes per operation
+    void print(std::ostream& out) const;
+};
@@ -0,0 +1,139 @@
+#include "HouseholdReport.hpp"
+#include "Simulator.hpp"
+#include <algorithm>
+#include <thread>
+
+namespace {
+    void addTo(AreaTotals& area, int kits) {
+        area.households++;
+        area.kits += kits;
+        if (kits >= MAX_KITS_PER_ADDRESS) {
+            area.atCap++;
+        }
+    }
+
+    void mergeInto(AreaTotals& area, const AreaTotals& other) {
+        area.households += other.households;
+        area.kits += other.kits;
+        area.atCap += other.atCap;
+    }
+
+    void printArea(std::ostream& out, const AreaTotals& area) {
+        out << area.households << " households, " << area.kits << " kits, " << area.atCap << " at the cap";
+    }
+}
+
+HouseholdReport::HouseholdReport() : households(0), kits(0), distribution(MAX_KITS_PER_ADDRESS + 1, 0) {}
+
+void HouseholdReport::add(int zip, const std::string& city, int k) {
+    households++;
+    kits += k;
+    if (k >= 0) {
+        if (k >= static_cast<int>(distribution.size())) {
+            distribution.resize(k + 1, 0);
+        }
+        distribution[k]++;
+    }
+    addTo(byZip[zip], k);
+    addTo(byCity[city], k);
+}
+
+void HouseholdReport::add(const StreetAddress& address, int k) {
+    add(address.zip, address.city, k);
+}
+
+void HouseholdReport::add(const AddressKey& address, int k) {
+    add(address.zip, address.cityName(), k);
+}
+
+void HouseholdReport::merge(const HouseholdReport& other) {
+    households += other.households;
+    kits += other.kits;
+    if (distribution.size() < other.distribution.size()) {
+        distribution.resize(other.distribution.size(), 0);
+    }
+    for (std::size_t i = 0; i < other.distribution.size(); i++) {
+        distribution[i] += other.distribution[i];
+    }
+    for (const auto& zip : other.byZip) {
+        mergeInto(byZip[zip.first], zip.second);
+    }
+    for (const auto& city : other.byCity) {
+        mergeInto(byCity[city.first], city.second);
+    }
+}
+
+void HouseholdReport::print(std::ostream& out, int topZips) const {
+    out << households << " households, " << kits << " kits, " << byZip.size() << " zip codes, "
+        << byCity.size() << " cities" << std::endl;
+    out << "kits per household:";
+    for (std::size_t i = 0; i < distribution.size(); i++) {
+        out << " " << i << ":" << distribution[i];
+    }
+    out << std::endl;
+
+    for (const auto& city : byCity) {
+        out << "  " << city.first << ": ";
+        printArea(out, city.second);
+        out << std::endl;
+    }
+
+    std::vector<std::pair<int, AreaTotals>> zips(byZip.begin(), byZip.end());
+    std::size_t shown = std::min(zips.size(), static_cast<std::size_t>(std::max(topZips, 0)));
+    std::partial_sort(zips.begin(), zips.begin() + shown, zips.end(),
+                      [](const std::pair<int, AreaTotals>& a, const std::pair<int, AreaTotals>& b) {
+                          return a.second.kits > b.second.kits;
+                      });
+    out << "top " << shown << " zip codes by kits:" << std::endl;
+    for (std::size_t i = 0; i < shown; i++) {
+        out << "  " << zips[i].first << ": ";
+        printArea(out, zips[i].second);
+        out << std::endl;
+    }
+}
+
+// the report building shared by both key types
+template<typename Key>
+HouseholdReport buildReportFor(const Dictionary<Key, int>& dict, int threads) {
+    if (threads <= 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    int slots = dict.slotCount();
+    threads = std::max(1, std::min(threads, slots));
+
+    // every thread reduces its own contiguous range of slots into its own report
+    std::vector<HouseholdReport> partial(threads);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        int begin = static_cast<int>(static_cast<long long>(slots) * t / threads);
+        int end = static_cast<int>(static_cast<long long>(slots) * (t + 1) / threads);
+        HouseholdReport& mine = partial[t];
+        auto scan = [&dict, &mine, begin, end] {
+            dict.forEachInRange(begin, end, [&mine](const Key& address, const int& kits) {
+                mine.add(address, kits);
+            });
+        };
+        if (t == threads - 1) {
+            scan(); // the calling thread takes the last range itself
+        } else {
+            workers.emplace_back(scan);
+        }
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    HouseholdReport report;
+    for (const HouseholdReport& part : partial) {
+        report.merge(part);
+    }
+    return report;
+}
+
+HouseholdReport buildReport(const Dictionary<StreetAddress, int>& dict, int threads) {
+    return buildReportFor(dict, threads);
+}
+
+HouseholdReport buildReport(const Dictionary<AddressKey, int>& dict, int threads) {
+    return buildReportFor(dict, threads);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "Dictionary.hpp"
+#include "StreetAddress.hpp"
+#include "AddressKey.hpp"
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Kit totals for one zip code or city
+struct AreaTotals {
+    long long households;  // households with at least one accepted order
+    long long kits;        // kits sent to them
+    long long atCap;       // households that reached MAX_KITS_PER_ADDRESS
+
+    AreaTotals() : households(0), kits(0), atCap(0) {}
+};
+
+// Aggregates over every household total in a dictionary
+struct HouseholdReport {
+    long long households;
+    long long kits;
+    std::vector<long long> distribution;    // distribution[k] = households that were sent k kits
+    std::map<int, AreaTotals> byZip;
+    std::map<std::string, AreaTotals> byCity;
+
+    HouseholdReport();
+
+    // Adds one household
+    void add(int zip, const std::string& city, int kits);
+    void add(const StreetAddress& address, int kits);
+    void add(const AddressKey& address, int kits);
+
+    // Adds everything from another report (e.g. one built by another thread)
+    void merge(const HouseholdReport& other);
+
+    // Prints the totals, the distribution, every city and the `topZips` zip codes with the most kits
+    void print(std::ostream& out, int topZips = 10) const;
+};
+
+// Builds a report from every record in `dict`, splitting the scan over `threads` threads
+// (0 means one per hardware thread). Each thread aggregates its share of the slots on its own,
+// and the partial reports are merged at the end.
+HouseholdReport buildReport(const Dictionary<StreetAddress, int>& dict, int threads = 0);
+HouseholdReport buildReport(const Dictionary<AddressKey, int>& dict, int threads = 0);
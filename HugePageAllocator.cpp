@@ -0,0 +1,224 @@
+#include "HugePageAllocator.hpp"
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    const std::size_t SMALL_PAGE_SIZE = 4096;
+
+    // from <linux/mempolicy.h>, which glibc doesn't wrap without libnuma
+    const int MPOL_PREFERRED_MODE = 1;
+
+    std::size_t roundUp(std::size_t bytes, std::size_t multiple) {
+        return (bytes + multiple - 1) / multiple * multiple;
+    }
+
+    // The NUMA node the calling thread is running on, or -1 if the kernel won't say
+    int currentNode() {
+#if defined(__linux__) && defined(SYS_getcpu)
+        unsigned cpu = 0;
+        unsigned node = 0;
+        if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0) {
+            return static_cast<int>(node);
+        }
+#endif
+        return -1;
+    }
+
+    // Asks for the pages of [p, p + bytes) to come from `node`; must happen before they're touched.
+    // Returns 0, or the errno saying why the kernel refused.
+    int preferNode(void* p, std::size_t bytes, int node) {
+#if defined(__linux__) && defined(SYS_mbind)
+        unsigned long mask = 0;
+        if (node < 0 || node >= static_cast<int>(sizeof(mask) * 8)) {
+            return EINVAL;
+        }
+        mask = 1UL << node;
+        // the kernel reads one bit fewer than maxnode says, so the mask's bit count plus one
+        if (syscall(SYS_mbind, p, bytes, MPOL_PREFERRED_MODE, &mask, sizeof(mask) * 8 + 1, 0) != 0) {
+            return errno;
+        }
+        return 0;
+#else
+        (void)p;
+        (void)bytes;
+        (void)node;
+        return ENOSYS;
+#endif
+    }
+}
+
+HugePageArena::HugePageArena(bool preferLocal)
+    : preferLocalNode(preferLocal), node(currentNode()), chunkNext(nullptr), chunkEnd(nullptr),
+      freeLists(SMALL_LIMIT / SMALL_ALIGNMENT + 1, nullptr), mapped(0), explicitMappings(0),
+      transparentMappings(0), smallPageMappings(0), boundMappings(0), unboundMappings(0), bindError(0) {}
+
+HugePageArena::~HugePageArena() {
+    for (void* chunk : chunks) {
+        unmapLarge(chunk, HUGE_PAGE_SIZE);
+    }
+}
+
+std::size_t HugePageArena::mappingSize(std::size_t bytes) {
+    // half a huge page or more is worth a whole one; anything less keeps small pages
+    if (bytes >= HUGE_PAGE_SIZE / 2) {
+        return roundUp(bytes, HUGE_PAGE_SIZE);
+    }
+    return roundUp(bytes, SMALL_PAGE_SIZE);
+}
+
+void* HugePageArena::mapLarge(std::size_t bytes) {
+#ifdef __linux__
+    std::size_t size = mappingSize(bytes);
+    void* p = MAP_FAILED;
+    if (size % HUGE_PAGE_SIZE == 0) {
+        // explicit huge pages, if the administrator reserved some (vm.nr_hugepages)
+        p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED) {
+            explicitMappings++;
+        } else {
+            // otherwise transparent huge pages: map a little extra so the block can start on a
+            // 2MB boundary, give the extra back, and ask for huge pages on what's left
+            std::size_t padded = size + HUGE_PAGE_SIZE;
+            void* raw = mmap(nullptr, padded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (raw != MAP_FAILED) {
+                char* start = static_cast<char*>(raw);
+                char* aligned = reinterpret_cast<char*>(roundUp(reinterpret_cast<std::size_t>(start), HUGE_PAGE_SIZE));
+                if (aligned > start) {
+                    munmap(start, aligned - start);
+                }
+                std::size_t tail = (start + padded) - (aligned + size);
+                if (tail > 0) {
+                    munmap(aligned + size, tail);
+                }
+                p = aligned;
+#ifdef MADV_HUGEPAGE
+                if (madvise(p, size, MADV_HUGEPAGE) == 0) {
+                    transparentMappings++;
+                } else {
+                    smallPageMappings++;
+                }
+#else
+                smallPageMappings++;
+#endif
+            }
+        }
+    } else {
+        p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p != MAP_FAILED) {
+            smallPageMappings++;
+        }
+    }
+    if (p == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+    if (preferLocalNode && node >= 0) {
+        int error = preferNode(p, size, node);
+        if (error == 0) {
+            boundMappings++;
+        } else {
+            unboundMappings++;
+            bindError = error;
+        }
+    }
+    mapped += size;
+    return p;
+#else
+    // no mmap: plain heap memory
+    return ::operator new(bytes);
+#endif
+}
+
+void HugePageArena::unmapLarge(void* p, std::size_t bytes) {
+#ifdef __linux__
+    std::size_t size = mappingSize(bytes);
+    munmap(p, size);
+    mapped -= size;
+#else
+    (void)bytes;
+    ::operator delete(p);
+#endif
+}
+
+void* HugePageArena::allocate(std::size_t bytes) {
+    if (bytes == 0) {
+        bytes = 1;
+    }
+    if (bytes > SMALL_LIMIT) {
+        return mapLarge(bytes);
+    }
+    std::size_t sizeClass = (bytes + SMALL_ALIGNMENT - 1) / SMALL_ALIGNMENT;
+    void* block = freeLists[sizeClass];
+    if (block != nullptr) {
+        // the first word of a free block links to the next one
+        freeLists[sizeClass] = *static_cast<void**>(block);
+        return block;
+    }
+    std::size_t size = sizeClass * SMALL_ALIGNMENT;
+    if (chunkNext == nullptr || static_cast<std::size_t>(chunkEnd - chunkNext) < size) {
+        // the rest of the old chunk is abandoned; at most SMALL_LIMIT bytes per chunk
+        chunkNext = static_cast<char*>(mapLarge(HUGE_PAGE_SIZE));
+        chunkEnd = chunkNext + HUGE_PAGE_SIZE;
+        chunks.push_back(chunkNext);
+    }
+    block = chunkNext;
+    chunkNext += size;
+    return block;
+}
+
+void HugePageArena::deallocate(void* p, std::size_t bytes) {
+    if (p == nullptr) {
+        return;
+    }
+    if (bytes == 0) {
+        bytes = 1;
+    }
+    if (bytes > SMALL_LIMIT) {
+        unmapLarge(p, bytes);
+        return;
+    }
+    std::size_t sizeClass = (bytes + SMALL_ALIGNMENT - 1) / SMALL_ALIGNMENT;
+    *static_cast<void**>(p) = freeLists[sizeClass];
+    freeLists[sizeClass] = p;
+}
+
+void HugePageArena::print(std::ostream& out) const {
+    out << "huge-page arena: " << mapped / (1 << 20) << " MB mapped in " << explicitMappings
+        << " explicit huge-page, " << transparentMappings << " transparent huge-page and " << smallPageMappings
+        << " small-page mappings";
+    if (preferLocalNode && node < 0) {
+        out << ", NUMA node unknown so none placed";
+    } else if (preferLocalNode) {
+        out << ", " << boundMappings << " placed on NUMA node " << node;
+        if (unboundMappings > 0) {
+            out << " (" << unboundMappings << " not: " << std::strerror(bindError) << ")";
+        }
+    }
+    long long thp = transparentHugePagesKb();
+    if (thp >= 0) {
+        out << "; process AnonHugePages " << thp / 1024 << " MB";
+    }
+    out << std::endl;
+}
+
+long long HugePageArena::transparentHugePagesKb() {
+    std::ifstream in("/proc/self/smaps_rollup");
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.compare(0, 14, "AnonHugePages:") == 0) {
+            std::istringstream fields(line.substr(14));
+            long long kb = -1;
+            fields >> kb;
+            return kb;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <ostream>
+#include <vector>
+
+// Memory for dictionaries, mapped straight from the kernel in a way that keeps TLB misses down.
+// Large blocks (record arrays, bucket arrays) get mappings of their own: explicit 2MB huge pages
+// (MAP_HUGETLB) when the system has some reserved, otherwise a 2MB-aligned mapping marked for
+// transparent huge pages (MADV_HUGEPAGE). Small blocks (chained-table nodes) are carved out of
+// shared 2MB chunks mapped the same way, with a free list per size.
+// If asked, every mapping prefers the NUMA node of the thread that created the arena.
+// An arena isn't thread-safe; like the dictionaries, it should be changed by one thread at a time.
+class HugePageArena {
+public:
+    static const std::size_t HUGE_PAGE_SIZE = 2 << 20;
+    static const std::size_t SMALL_LIMIT = 1024; // bigger blocks get mappings of their own
+
+private:
+    static const std::size_t SMALL_ALIGNMENT = 16;
+
+    bool preferLocalNode;
+    int node;                          // the creating thread's NUMA node, or -1 if unknown
+
+    std::vector<void*> chunks;         // the chunks small blocks are carved from
+    char* chunkNext;                   // the unused part of the newest chunk
+    char* chunkEnd;
+    std::vector<void*> freeLists;      // freeLists[c]: freed small blocks of c * SMALL_ALIGNMENT bytes
+
+    std::size_t mapped;                // bytes currently mapped
+    int explicitMappings;              // mappings backed by MAP_HUGETLB pages
+    int transparentMappings;           // mappings advised to use transparent huge pages
+    int smallPageMappings;             // mappings too small for huge pages
+    int boundMappings;                 // mappings the NUMA preference was applied to
+    int unboundMappings;               // mappings the kernel wouldn't apply it to
+    int bindError;                     // the errno of the latest refusal
+
+    // How many bytes the mapping for a large block of `bytes` takes
+    static std::size_t mappingSize(std::size_t bytes);
+
+    void* mapLarge(std::size_t bytes);
+    void unmapLarge(void* p, std::size_t bytes);
+
+public:
+    // `preferLocalNode`: place memory on the NUMA node this constructor runs on
+    explicit HugePageArena(bool preferLocalNode = true);
+    ~HugePageArena();
+
+    // An arena owns its mappings, so it can't be copied
+    HugePageArena(const HugePageArena&) = delete;
+    HugePageArena& operator=(const HugePageArena&) = delete;
+
+    // Throws std::bad_alloc if the kernel refuses the memory
+    void* allocate(std::size_t bytes);
+    void deallocate(void* p, std::size_t bytes);
+
+    // Prints how much is mapped, what kind of pages back it, and whether the NUMA preference took
+    void print(std::ostream& out) const;
+
+    // Transparent huge pages this process is using right now (AnonHugePages), in kB, or -1 if unknown
+    static long long transparentHugePagesKb();
+};
+
+// A standard allocator over a shared HugePageArena. Copies (including rebound ones) share the arena,
+// so a dictionary's records and nodes all come from the same mappings.
+template<typename T>
+class HugePageAllocator {
+private:
+    std::shared_ptr<HugePageArena> arena;
+
+    template<typename U>
+    friend class HugePageAllocator;
+
+public:
+    typedef T value_type;
+
+    static_assert(alignof(T) <= 16, "HugePageAllocator only aligns blocks to 16 bytes");
+
+    // a new arena of its own
+    HugePageAllocator() : arena(std::make_shared<HugePageArena>()) {}
+
+    explicit HugePageAllocator(std::shared_ptr<HugePageArena> a) : arena(std::move(a)) {}
+
+    template<typename U>
+    HugePageAllocator(const HugePageAllocator<U>& other) : arena(other.arena) {}
+
+    T* allocate(std::size_t n) {
+        if (n > static_cast<std::size_t>(-1) / sizeof(T)) {
+            throw std::bad_alloc();
+        }
+        return static_cast<T*>(arena->allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, std::size_t n) {
+        arena->deallocate(p, n * sizeof(T));
+    }
+
+    const std::shared_ptr<HugePageArena>& memory() const {
+        return arena;
+    }
+};
+
+template<typename T, typename U>
+bool operator==(const HugePageAllocator<T>& a, const HugePageAllocator<U>& b) {
+    return a.memory() == b.memory();
+}
+
+template<typename T, typename U>
+bool operator!=(const HugePageAllocator<T>& a, const HugePageAllocator<U>& b) {
+    return !(a == b);
+}
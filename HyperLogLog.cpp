@@ -0,0 +1,72 @@
+#include "HyperLogLog.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+HyperLogLog::HyperLogLog(int p) : precision(p) {
+    if (p < MIN_PRECISION || p > MAX_PRECISION) {
+        throw std::runtime_error("HyperLogLog: precision must be between 4 and 18");
+    }
+    registers.assign(static_cast<std::size_t>(1) << p, 0);
+}
+
+void HyperLogLog::add(std::uint64_t hash) {
+    // the top bits pick a register, which keeps the longest run of leading zeros seen in the rest
+    std::size_t index = static_cast<std::size_t>(hash >> (64 - precision));
+    std::uint64_t rest = hash << precision;
+    std::uint8_t rank = 1;
+    while (rank <= 64 - precision && (rest & (static_cast<std::uint64_t>(1) << 63)) == 0) {
+        rest <<= 1;
+        rank++;
+    }
+    if (rank > registers[index]) {
+        registers[index] = rank;
+    }
+}
+
+void HyperLogLog::merge(const HyperLogLog& other) {
+    if (other.precision != precision) {
+        throw std::runtime_error("HyperLogLog: can't merge sketches of different precision");
+    }
+    for (std::size_t i = 0; i < registers.size(); i++) {
+        registers[i] = std::max(registers[i], other.registers[i]);
+    }
+}
+
+double HyperLogLog::estimate() const {
+    const double m = static_cast<double>(registers.size());
+    double alpha;
+    if (registers.size() == 16) {
+        alpha = 0.673;
+    } else if (registers.size() == 32) {
+        alpha = 0.697;
+    } else if (registers.size() == 64) {
+        alpha = 0.709;
+    } else {
+        alpha = 0.7213 / (1 + 1.079 / m);
+    }
+
+    double sum = 0;
+    int zeros = 0;
+    for (std::uint8_t r : registers) {
+        sum += std::ldexp(1.0, -r);
+        if (r == 0) {
+            zeros++;
+        }
+    }
+    double raw = alpha * m * m / sum;
+
+    // with few values many registers are still empty, and counting them is more accurate
+    if (raw <= 2.5 * m && zeros > 0) {
+        return m * std::log(m / zeros);
+    }
+    return raw;
+}
+
+double HyperLogLog::relativeError() const {
+    return 1.04 / std::sqrt(static_cast<double>(registers.size()));
+}
+
+void HyperLogLog::clear() {
+    std::fill(registers.begin(), registers.end(), 0);
+}
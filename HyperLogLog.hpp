@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// A HyperLogLog sketch: estimates how many distinct values it has seen using 2^precision
+// one-byte registers, whatever the number of values. The relative standard error is about
+// 1.04 / sqrt(2^precision), so the default precision of 14 (16KB) is within about 0.8%.
+// Values are added as 64-bit hashes, which should be well mixed (see cs20::hash64).
+class HyperLogLog {
+public:
+    static const int MIN_PRECISION = 4;
+    static const int MAX_PRECISION = 18;
+
+private:
+    int precision;
+    std::vector<std::uint8_t> registers;
+
+public:
+    // Throws a runtime_error if precision is outside MIN_PRECISION .. MAX_PRECISION
+    explicit HyperLogLog(int precision = 14);
+
+    // Records one value, given its hash
+    void add(std::uint64_t hash);
+
+    // Adds everything `other` has seen; both sketches must have the same precision
+    void merge(const HyperLogLog& other);
+
+    // The estimated number of distinct values added so far
+    double estimate() const;
+
+    // The relative standard error of estimate()
+    double relativeError() const;
+
+    // Forgets every value
+    void clear();
+};
@@ -0,0 +1,114 @@
+#include "LatencyHistogram.hpp"
+#include <algorithm>
+#include <climits>
+
+LatencyHistogram::LatencyHistogram() : counts(BUCKET_COUNT, 0) {
+    clear();
+}
+
+int LatencyHistogram::indexFor(long long value) {
+    unsigned long long v = static_cast<unsigned long long>(value);
+    if (v < static_cast<unsigned long long>(SUB_BUCKET_COUNT)) {
+        return static_cast<int>(v); // small values are stored exactly
+    }
+    // keep the top SUB_BUCKET_BITS - 1 bits below the leading one
+    int msb = 63 - __builtin_clzll(v);
+    int shift = msb - (SUB_BUCKET_BITS - 1);
+    return shift * SUB_BUCKET_HALF + static_cast<int>(v >> shift);
+}
+
+long long LatencyHistogram::lowestValueFor(int index) {
+    if (index < SUB_BUCKET_COUNT) {
+        return index;
+    }
+    int shift = index / SUB_BUCKET_HALF - 1;
+    long long mantissa = index - shift * SUB_BUCKET_HALF;
+    return mantissa << shift;
+}
+
+long long LatencyHistogram::highestValueFor(int index) {
+    if (index < SUB_BUCKET_COUNT) {
+        return index;
+    }
+    int shift = index / SUB_BUCKET_HALF - 1;
+    return lowestValueFor(index) + (1LL << shift) - 1;
+}
+
+void LatencyHistogram::record(long long value) {
+    if (value < 0) {
+        value = 0;
+    }
+    counts[indexFor(value)]++;
+    total++;
+    sum += static_cast<double>(value);
+    if (value < minValue) {
+        minValue = value;
+    }
+    if (value > maxValue) {
+        maxValue = value;
+    }
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+    for (int i = 0; i < BUCKET_COUNT; i++) {
+        counts[i] += other.counts[i];
+    }
+    total += other.total;
+    sum += other.sum;
+    minValue = std::min(minValue, other.minValue);
+    maxValue = std::max(maxValue, other.maxValue);
+}
+
+void LatencyHistogram::clear() {
+    std::fill(counts.begin(), counts.end(), 0);
+    total = 0;
+    sum = 0;
+    minValue = LLONG_MAX;
+    maxValue = 0;
+}
+
+long long LatencyHistogram::count() const {
+    return total;
+}
+
+long long LatencyHistogram::min() const {
+    return total == 0 ? 0 : minValue;
+}
+
+long long LatencyHistogram::max() const {
+    return maxValue;
+}
+
+double LatencyHistogram::mean() const {
+    return total == 0 ? 0 : sum / total;
+}
+
+long long LatencyHistogram::percentile(double p) const {
+    if (total == 0) {
+        return 0;
+    }
+    p = std::min(100.0, std::max(0.0, p));
+    // the rank of the wanted value, counting from 1
+    long long rank = static_cast<long long>(p / 100.0 * total + 0.5);
+    rank = std::max(1LL, std::min(rank, total));
+
+    long long seen = 0;
+    for (int i = 0; i < BUCKET_COUNT; i++) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return std::min(highestValueFor(i), maxValue);
+        }
+    }
+    return maxValue;
+}
+
+void LatencyHistogram::print(std::ostream& out, const std::string& unit) const {
+    out << "count=" << count()
+        << " min=" << min() << unit
+        << " mean=" << static_cast<long long>(mean()) << unit
+        << " p50=" << percentile(50) << unit
+        << " p90=" << percentile(90) << unit
+        << " p99=" << percentile(99) << unit
+        << " p99.9=" << percentile(99.9) << unit
+        << " max=" << max() << unit;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+// An HDR-style histogram of non-negative measurements (e.g. per-order latencies in nanoseconds).
+// Values are kept in log-linear buckets: every power-of-two range is split into
+// 64 equal sub-buckets, so any recorded value is reproduced within ~1.6%,
+// recording is a handful of integer operations, and the memory used is fixed.
+class LatencyHistogram {
+private:
+    static const int SUB_BUCKET_BITS = 7;                        // precision of each bucket
+    static const int SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;    // values below this are exact
+    static const int SUB_BUCKET_HALF = SUB_BUCKET_COUNT / 2;     // sub-buckets per power of two
+    static const int BUCKET_COUNT = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKET_HALF + SUB_BUCKET_HALF;
+
+    std::vector<long long> counts; // how many values fell into each bucket
+    long long total;               // how many values were recorded
+    long long minValue;
+    long long maxValue;
+    double sum;                    // for the mean
+
+    // Which bucket a value belongs to
+    static int indexFor(long long value);
+
+    // The smallest and largest value that land in a bucket
+    static long long lowestValueFor(int index);
+    static long long highestValueFor(int index);
+
+public:
+    LatencyHistogram();
+
+    // Adds one measurement (negative values are counted as 0)
+    void record(long long value);
+
+    // Adds every measurement from another histogram
+    void merge(const LatencyHistogram& other);
+
+    // Forgets every measurement
+    void clear();
+
+    // Summary statistics; min/max/mean/percentile return 0 when nothing was recorded
+    long long count() const;
+    long long min() const;
+    long long max() const;
+    double mean() const;
+
+    // The value that `p` percent of the measurements are at or below, for p in [0, 100]
+    long long percentile(double p) const;
+
+    // Prints a one-line summary: count, min, mean, p50, p90, p99, p99.9, max
+    void print(std::ostream& out, const std::string& unit = "ns") const;
+};
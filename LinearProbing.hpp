@@ -0,0 +1,53 @@
+#pragma once
+
+// The open-addressing probe loop shared by HashTableClosed and MappedHashTable, so a table and a
+// snapshot of it find every key in the same slot.
+//
+// Slot i of a key's probe sequence is (hash + skip * i) % capacity. The walk stops at the key,
+// at the first empty slot, or after `capacity` slots.
+
+namespace cs20 {
+    // Where a probe sequence led
+    struct ProbeResult {
+        int found;    // the slot holding the key, or -1
+        int insertAt; // where the key would go: the first tombstone seen, else the empty slot
+                      // that ended the walk; -1 if the walk never reached an empty slot
+        int probes;   // how many slots were looked at
+    };
+
+    // The slot of the i-th probe for a hash value
+    inline int probeSlot(int hashValue, int i, int skip, int capacity) {
+        long long slot = (static_cast<long long>(hashValue) + static_cast<long long>(skip) * i) % capacity;
+        return static_cast<int>(slot < 0 ? slot + capacity : slot);
+    }
+
+    // Walks the probe sequence of `hashValue`. `isEmpty(slot)` and `isTombstone(slot)` describe a slot,
+    // and `matches(slot)` says whether it holds a record with the key being looked for.
+    template<typename IsEmpty, typename IsTombstone, typename Matches>
+    ProbeResult linearProbe(int hashValue, int skip, int capacity,
+                            IsEmpty isEmpty, IsTombstone isTombstone, Matches matches) {
+        ProbeResult result = {-1, -1, capacity};
+        for (int i = 0; i < capacity; i++) {
+            int slot = probeSlot(hashValue, i, skip, capacity);
+            if (isEmpty(slot)) {
+                if (result.insertAt == -1) {
+                    result.insertAt = slot;
+                }
+                result.probes = i + 1;
+                return result;
+            }
+            if (isTombstone(slot)) {
+                if (result.insertAt == -1) {
+                    result.insertAt = slot;
+                }
+            } else if (matches(slot)) {
+                result.found = slot;
+                result.probes = i + 1;
+                return result;
+            }
+        }
+        // a full walk past only records and tombstones: the table counts as full
+        result.insertAt = -1;
+        return result;
+    }
+}
@@ -0,0 +1,142 @@
+#include "LoadGenerator.hpp"
+#include "OrderProtocol.hpp"
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+    long long nowNanos() {
+        auto now = std::chrono::steady_clock::now().time_since_epoch();
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+    }
+
+    std::runtime_error failure(const std::string& what) {
+        return std::runtime_error("runLoad: " + what + ": " + std::strerror(errno));
+    }
+
+    // Closes the socket however runLoad exits
+    struct SocketGuard {
+        int fd;
+        ~SocketGuard() {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+    };
+}
+
+LoadReport runLoad(const std::string& socketPath, const std::vector<COVIDTestOrder>& orders, int pipelineDepth) {
+    if (pipelineDepth < 1) {
+        pipelineDepth = 1;
+    }
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("runLoad: socket path is too long: " + socketPath);
+    }
+    std::memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+    SocketGuard sock = {socket(AF_UNIX, SOCK_STREAM, 0)};
+    if (sock.fd < 0) {
+        throw failure("can't create socket");
+    }
+    if (connect(sock.fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        throw failure("can't connect to " + socketPath);
+    }
+
+    // reads and writes are interleaved, so the server never waits on responses we aren't reading
+    // while we wait on it to take more requests
+    fcntl(sock.fd, F_SETFL, fcntl(sock.fd, F_GETFL, 0) | O_NONBLOCK);
+
+    LoadReport report;
+    std::deque<long long> sentAt; // send times of the requests in flight, oldest first
+    std::string out;              // requests not yet written
+    std::size_t outStart = 0;     // how much of `out` has been written
+    std::string in;
+    char buffer[64 * 1024];
+    std::size_t next = 0;
+    long long start = nowNanos();
+
+    while (report.requests < static_cast<long long>(orders.size())) {
+        // top the pipeline up
+        long long queuedAt = nowNanos();
+        while (next < orders.size() && static_cast<int>(sentAt.size()) < pipelineDepth) {
+            OrderProtocol::encodeRequest(orders[next], out);
+            sentAt.push_back(queuedAt);
+            next++;
+        }
+
+        pollfd ready;
+        ready.fd = sock.fd;
+        ready.events = POLLIN | (outStart < out.size() ? POLLOUT : 0);
+        ready.revents = 0;
+        if (poll(&ready, 1, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw failure("poll failed");
+        }
+
+        // send as much as the socket takes
+        if (ready.revents & POLLOUT) {
+            ssize_t n = write(sock.fd, out.data() + outStart, out.size() - outStart);
+            if (n > 0) {
+                outStart += static_cast<std::size_t>(n);
+                if (outStart == out.size()) {
+                    out.clear();
+                    outStart = 0;
+                }
+            } else if (n < 0 && errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK) {
+                throw failure("write failed");
+            }
+        }
+        if (!(ready.revents & (POLLIN | POLLHUP | POLLERR))) {
+            continue;
+        }
+
+        // take every complete response that arrived
+        ssize_t n = read(sock.fd, buffer, sizeof(buffer));
+        if (n == 0) {
+            throw std::runtime_error("runLoad: the server closed the connection");
+        } else if (n < 0) {
+            if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK) {
+                continue;
+            }
+            throw failure("read failed");
+        }
+        in.append(buffer, static_cast<std::size_t>(n));
+        long long arrived = nowNanos();
+
+        std::size_t consumed = 0;
+        const char* payload;
+        std::size_t payloadBytes;
+        while (std::size_t size = OrderProtocol::nextMessage(in.data() + consumed, in.size() - consumed,
+                                                             payload, payloadBytes)) {
+            bool accepted;
+            int total;
+            OrderProtocol::decodeResponse(payload, payloadBytes, accepted, total);
+            if (sentAt.empty()) {
+                throw std::runtime_error("runLoad: the server sent more responses than requests");
+            }
+            report.latencies.record(arrived - sentAt.front());
+            sentAt.pop_front();
+            report.requests++;
+            if (accepted) {
+                report.accepted++;
+            }
+            consumed += size;
+        }
+        in.erase(0, consumed);
+    }
+
+    report.seconds = (nowNanos() - start) / 1e9;
+    return report;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "COVIDTestOrder.hpp"
+#include "LatencyHistogram.hpp"
+#include <string>
+#include <vector>
+
+// What a load generator run measured
+struct LoadReport {
+    long long requests;          // responses received
+    long long accepted;          // of which accepted
+    double seconds;              // from the first request sent to the last response received
+    LatencyHistogram latencies;  // per request, from being queued to send to its response arriving, in nanoseconds
+
+    LoadReport() : requests(0), accepted(0), seconds(0) {}
+};
+
+// Sends every order to the OrderServer listening at `socketPath` over one connection,
+// keeping up to `pipelineDepth` requests in flight, and measures latency and throughput.
+// Responses are read while requests are still being written, so any depth is safe against
+// the server's back-pressure.
+// Throws a runtime_error if the server can't be reached or the connection fails.
+LoadReport runLoad(const std::string& socketPath, const std::vector<COVIDTestOrder>& orders, int pipelineDepth);
@@ -0,0 +1,361 @@
+#include "MappedHashTable.hpp"
+#include "hashing.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace {
+    const char MAGIC[8] = {'C', 'T', 'S', 'N', 'A', 'P', 0, 0};
+
+    // rounds up to a multiple of 8, so every section of the file is aligned
+    std::uint64_t align8(std::uint64_t n) {
+        return (n + 7) & ~static_cast<std::uint64_t>(7);
+    }
+
+    // whether `bytes` starting at `offset` fit in `total`, without the sum wrapping around
+    bool fits(std::uint64_t offset, std::uint64_t bytes, std::uint64_t total) {
+        return offset <= total && bytes <= total - offset;
+    }
+
+    std::runtime_error failure(const std::string& what, const std::string& path) {
+        return std::runtime_error("MappedHashTable: " + what + " " + path + ": " + std::strerror(errno));
+    }
+}
+
+MappedHashTable::MappedHashTable(const std::string& path) : fd(-1), mapping(MAP_FAILED), mappingBytes(0), orders(0) {
+    fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw failure("can't open", path);
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        throw failure("can't stat", path);
+    }
+    mappingBytes = static_cast<std::size_t>(info.st_size);
+    if (mappingBytes < sizeof(Header)) {
+        close(fd);
+        throw std::runtime_error("MappedHashTable: " + path + " is not a snapshot");
+    }
+    // private and writable: our changes are copy-on-write and never reach the file
+    mapping = mmap(nullptr, mappingBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        throw failure("can't map", path);
+    }
+
+    const Header* header = static_cast<const Header*>(mapping);
+    const std::uint64_t slotBytes = static_cast<std::uint64_t>(header->capacity) * sizeof(Slot);
+    bool valid = std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) == 0
+              && header->version == VERSION
+              && header->fileBytes == mappingBytes
+              && header->capacity > 0 && header->probeSkip > 0
+              && header->length >= 0 && header->length <= header->capacity
+              && header->ordersProcessed >= 0
+              && header->slotsOffset % alignof(Slot) == 0
+              && fits(header->slotsOffset, slotBytes, mappingBytes)
+              && fits(header->flagsOffset, static_cast<std::uint64_t>(header->capacity), mappingBytes)
+              && fits(header->stringsOffset, header->stringsBytes, mappingBytes);
+    if (!valid) {
+        munmap(mapping, mappingBytes);
+        close(fd);
+        throw std::runtime_error("MappedHashTable: " + path + " is not a valid snapshot");
+    }
+
+    char* base = static_cast<char*>(mapping);
+    M = header->capacity;
+    probe_constant = header->probeSkip;
+    length = header->length;
+    orders = header->ordersProcessed;
+    slots = reinterpret_cast<Slot*>(base + header->slotsOffset);
+    flags = reinterpret_cast<std::uint8_t*>(base + header->flagsOffset);
+    strings = base + header->stringsOffset;
+    try {
+        validateSlots(path, header->stringsBytes);
+    } catch (const std::exception&) {
+        munmap(mapping, mappingBytes);
+        close(fd);
+        throw;
+    }
+}
+
+void MappedHashTable::validateSlots(const std::string& path, std::uint64_t stringsBytes) const {
+    // flags and names are only trusted once they are known to stay inside the mapping; offsets
+    // into the in-memory pool can't appear in a file
+    int records = 0;
+    for (int i = 0; i < M; i++) {
+        if (flags[i] == EMPTY || flags[i] == TOMBSTONE) {
+            continue;
+        }
+        const Slot& slot = slots[i];
+        bool valid = flags[i] == RECORD
+                  && (slot.streetOffset & EXTRA_STRING) == 0 && (slot.cityOffset & EXTRA_STRING) == 0
+                  && static_cast<std::uint64_t>(slot.streetOffset) + slot.streetLength <= stringsBytes
+                  && static_cast<std::uint64_t>(slot.cityOffset) + slot.cityLength <= stringsBytes;
+        if (!valid) {
+            throw std::runtime_error("MappedHashTable: " + path + " has a corrupt slot " + std::to_string(i));
+        }
+        records++;
+    }
+    if (records != length) {
+        throw std::runtime_error("MappedHashTable: " + path + " has " + std::to_string(records)
+                                 + " records, its header says " + std::to_string(length));
+    }
+}
+
+MappedHashTable::~MappedHashTable() {
+    munmap(mapping, mappingBytes);
+    close(fd);
+}
+
+cs20::ProbeResult MappedHashTable::probeFor(const StreetAddress& k) const {
+    return cs20::linearProbe(cs20::hash(k), probe_constant, M,
+        [this](int slot) { return flags[slot] == EMPTY; },
+        [this](int slot) { return flags[slot] == TOMBSTONE; },
+        [this, &k](int slot) { return matches(slots[slot], k); });
+}
+
+const char* MappedHashTable::text(std::uint32_t offset) const {
+    if (offset & EXTRA_STRING) {
+        return extraStrings.data() + (offset & ~EXTRA_STRING);
+    }
+    return strings + offset;
+}
+
+void MappedHashTable::keyOf(const Slot& slot, StreetAddress& key) const {
+    key.number = slot.number;
+    key.zip = slot.zip;
+    key.street.assign(text(slot.streetOffset), slot.streetLength);
+    key.city.assign(text(slot.cityOffset), slot.cityLength);
+}
+
+bool MappedHashTable::matches(const Slot& slot, const StreetAddress& k) const {
+    return slot.number == k.number && slot.zip == k.zip
+        && slot.streetLength == k.street.size() && slot.cityLength == k.city.size()
+        && std::memcmp(text(slot.streetOffset), k.street.data(), slot.streetLength) == 0
+        && std::memcmp(text(slot.cityOffset), k.city.data(), slot.cityLength) == 0;
+}
+
+std::uint32_t MappedHashTable::addExtraString(const std::string& s) {
+    if (s.size() > 0xffff || extraStrings.size() + s.size() >= EXTRA_STRING) {
+        throw std::runtime_error("insert: error, street or city name is too long");
+    }
+    std::uint32_t offset = static_cast<std::uint32_t>(extraStrings.size());
+    extraStrings.insert(extraStrings.end(), s.begin(), s.end());
+    return offset | EXTRA_STRING;
+}
+
+void MappedHashTable::clear() {
+    length = 0;
+    std::memset(flags, EMPTY, M);
+    extraStrings.clear();
+}
+
+int MappedHashTable::find(const StreetAddress& k) const {
+    cs20::ProbeResult result = probeFor(k);
+    if (result.found == -1) {
+        throw std::runtime_error("find: error, key not found");
+    }
+    return slots[result.found].value;
+}
+
+void MappedHashTable::insert(const StreetAddress& k, const int& v) {
+    if (length >= M) {
+        throw std::runtime_error("insert: error, the hash table is full");
+    }
+
+    cs20::ProbeResult result = probeFor(k);
+    if (result.found != -1) {
+        // key already exists - update value
+        slots[result.found].value = v;
+        return;
+    }
+    if (result.insertAt == -1) {
+        throw std::runtime_error("insert: error, the hash table is full");
+    }
+    Slot& slot = slots[result.insertAt];
+    slot.number = k.number;
+    slot.zip = k.zip;
+    slot.value = v;
+    slot.streetOffset = addExtraString(k.street);
+    slot.cityOffset = addExtraString(k.city);
+    slot.streetLength = static_cast<std::uint16_t>(k.street.size());
+    slot.cityLength = static_cast<std::uint16_t>(k.city.size());
+    flags[result.insertAt] = RECORD;
+    length++;
+}
+
+void MappedHashTable::remove(const StreetAddress& k) {
+    cs20::ProbeResult result = probeFor(k);
+    if (result.found == -1) {
+        throw std::runtime_error("remove: error, key not found");
+    }
+    flags[result.found] = TOMBSTONE;
+    length--;
+}
+
+long long MappedHashTable::ordersProcessed() const {
+    return orders;
+}
+
+void MappedHashTable::setOrdersProcessed(long long count) {
+    orders = count;
+}
+
+int MappedHashTable::size() const {
+    return length;
+}
+
+int MappedHashTable::slotCount() const {
+    return M;
+}
+
+void MappedHashTable::reserve(int capacity) {
+    if (capacity <= M) {
+        return;
+    }
+    std::vector<Slot> newSlots(capacity);
+    std::vector<std::uint8_t> newFlags(capacity, EMPTY);
+
+    // a slot's name offsets stay valid, so records move as they are, to the first empty slot
+    // of their new probe sequence; the old slots are only hashed, and tombstones are dropped
+    StreetAddress key;
+    for (int slot = 0; slot < M; slot++) {
+        if (flags[slot] != RECORD) {
+            continue;
+        }
+        keyOf(slots[slot], key);
+        cs20::ProbeResult result = cs20::linearProbe(cs20::hash(key), probe_constant, capacity,
+            [&newFlags](int i) { return newFlags[i] == EMPTY; },
+            [](int) { return false; },
+            [](int) { return false; });
+        newSlots[result.insertAt] = slots[slot];
+        newFlags[result.insertAt] = RECORD;
+    }
+
+    grownSlots.swap(newSlots);
+    grownFlags.swap(newFlags);
+    slots = grownSlots.data();
+    flags = grownFlags.data();
+    M = capacity;
+}
+
+void MappedHashTable::forEachInRange(int begin, int end,
+                                     const std::function<void(const StreetAddress&, const int&)>& visit) const {
+    StreetAddress key; // reused, so the strings keep their capacity
+    for (int i = begin; i < end && i < M; i++) {
+        if (flags[i] == RECORD) {
+            keyOf(slots[i], key);
+            int value = slots[i].value;
+            visit(key, value);
+        }
+    }
+}
+
+template<typename SlotAt>
+void MappedHashTable::writeSnapshot(const std::string& path, int capacity, int probeSkip, int length,
+                                    long long ordersProcessed, SlotAt slotAt) {
+    std::vector<Slot> slotArray(capacity);
+    std::vector<std::uint8_t> flagArray(capacity, EMPTY);
+    std::string pool;
+    std::unordered_map<std::string, std::uint32_t> pooled; // street and city names repeat a lot
+
+    auto intern = [&](const std::string& s) {
+        auto found = pooled.find(s);
+        if (found != pooled.end()) {
+            return found->second;
+        }
+        if (s.size() > 0xffff || pool.size() + s.size() >= EXTRA_STRING) {
+            throw std::runtime_error("MappedHashTable: error, too much text for a snapshot");
+        }
+        std::uint32_t offset = static_cast<std::uint32_t>(pool.size());
+        pool += s;
+        pooled.emplace(s, offset);
+        return offset;
+    };
+
+    StreetAddress key;
+    int value;
+    for (int i = 0; i < capacity; i++) {
+        std::uint8_t flag = slotAt(i, key, value);
+        flagArray[i] = flag;
+        Slot& slot = slotArray[i];
+        std::memset(&slot, 0, sizeof(slot));
+        if (flag == RECORD) {
+            slot.number = key.number;
+            slot.zip = key.zip;
+            slot.value = value;
+            slot.streetOffset = intern(key.street);
+            slot.cityOffset = intern(key.city);
+            slot.streetLength = static_cast<std::uint16_t>(key.street.size());
+            slot.cityLength = static_cast<std::uint16_t>(key.city.size());
+        }
+    }
+
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.capacity = capacity;
+    header.probeSkip = probeSkip;
+    header.length = length;
+    header.ordersProcessed = ordersProcessed;
+    header.slotsOffset = align8(sizeof(Header));
+    header.flagsOffset = align8(header.slotsOffset + static_cast<std::uint64_t>(capacity) * sizeof(Slot));
+    header.stringsOffset = align8(header.flagsOffset + capacity);
+    header.stringsBytes = pool.size();
+    header.fileBytes = header.stringsOffset + pool.size();
+
+    // written next to the destination and renamed over it, so a crash never leaves a half-written
+    // snapshot and a table that is still mapping the old file keeps its (now unlinked) copy
+    std::string temporary = path + ".tmp";
+    std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw failure("can't create", temporary);
+    }
+    const char zeros[8] = {};
+    auto pad = [&](std::uint64_t to) {
+        out.write(zeros, static_cast<std::streamsize>(to - static_cast<std::uint64_t>(out.tellp())));
+    };
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    pad(header.slotsOffset);
+    out.write(reinterpret_cast<const char*>(slotArray.data()), static_cast<std::streamsize>(capacity * sizeof(Slot)));
+    pad(header.flagsOffset);
+    out.write(reinterpret_cast<const char*>(flagArray.data()), capacity);
+    pad(header.stringsOffset);
+    out.write(pool.data(), static_cast<std::streamsize>(pool.size()));
+    out.close();
+    if (!out) {
+        throw failure("can't write", temporary);
+    }
+    if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+        throw failure("can't rename to", path);
+    }
+}
+
+void MappedHashTable::save(const std::string& path) const {
+    writeSnapshot(path, M, probe_constant, length, orders, [this](int i, StreetAddress& key, int& value) {
+        if (flags[i] == RECORD) {
+            keyOf(slots[i], key);
+            value = slots[i].value;
+        }
+        return flags[i];
+    });
+}
+
+void MappedHashTable::writeTable(const std::string& path, int capacity, int probeSkip, int length,
+                                 long long ordersProcessed,
+                                 const std::function<std::uint8_t(int, StreetAddress&, int&)>& slotAt) {
+    writeSnapshot(path, capacity, probeSkip, length, ordersProcessed, slotAt);
+}
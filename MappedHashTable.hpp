@@ -0,0 +1,159 @@
+#pragma once
+
+#include "Dictionary.hpp"
+#include "HashTableClosed.hpp"
+#include "LinearProbing.hpp"
+#include "StreetAddress.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A HashTableClosed<StreetAddress, int> that lives in a memory-mapped snapshot file.
+//
+// A snapshot stores the slot array and the slot flags exactly as the hash table had them,
+// with every street and city name moved into a shared string pool and referred to by offset,
+// so nothing in the file depends on where it is mapped. Loading one is an mmap plus one read-only
+// pass that checks every slot's flag and names against the mapping: the slots are used where they
+// are, with the same hash function and probe sequence, so nothing is rehashed or copied.
+// The snapshot also records how many orders its totals cover, so a restarted run can carry on
+// from the next one.
+//
+// The mapping is private (copy-on-write): updates, removals and new households change the
+// table in memory only. Names of households added after loading go into a separate in-memory
+// pool. reserve() moves the slots out of the mapping into a bigger in-memory table; the names stay
+// where they are. Call save() to write the current state to a new snapshot.
+class MappedHashTable : public Dictionary<StreetAddress, int> {
+private:
+    // The file header; all offsets are from the start of the file
+    struct Header {
+        char magic[8];             // "CTSNAP\0\0"
+        std::uint32_t version;
+        std::int32_t capacity;     // number of slots
+        std::int32_t probeSkip;    // linear probing constant
+        std::int32_t length;       // number of records
+        std::int64_t ordersProcessed; // orders applied to the table when it was saved
+        std::uint64_t slotsOffset;
+        std::uint64_t flagsOffset;
+        std::uint64_t stringsOffset;
+        std::uint64_t stringsBytes;
+        std::uint64_t fileBytes;
+    };
+
+    // One slot of the table
+    struct Slot {
+        std::int32_t number;
+        std::int32_t zip;
+        std::int32_t value;
+        std::uint32_t streetOffset; // into the string pool; EXTRA_STRING set means the in-memory pool
+        std::uint32_t cityOffset;
+        std::uint16_t streetLength;
+        std::uint16_t cityLength;
+    };
+
+    // Flag values, matching HashTableClosed::SlotType
+    static constexpr std::uint8_t EMPTY = 0;
+    static constexpr std::uint8_t TOMBSTONE = 1;
+    static constexpr std::uint8_t RECORD = 2;
+
+    static const std::uint32_t VERSION = 2;
+    static const std::uint32_t EXTRA_STRING = 0x80000000u;
+
+    int fd;
+    void* mapping;
+    std::size_t mappingBytes;
+
+    int M;                   // number of slots
+    int probe_constant;      // linear probing constant
+    int length;              // number of records
+    long long orders;        // orders applied so far: the snapshot's, plus any set since loading
+    Slot* slots;             // in the mapping, or in grownSlots after reserve()
+    std::uint8_t* flags;     // in the mapping, or in grownFlags after reserve()
+    const char* strings;     // the snapshot's string pool, in the mapping
+    std::vector<char> extraStrings; // names of households added after loading
+    std::vector<Slot> grownSlots;   // the slots once reserve() has outgrown the snapshot's
+    std::vector<std::uint8_t> grownFlags;
+
+    // Walks the probe sequence of an address, the same way HashTableClosed does (see LinearProbing.hpp)
+    cs20::ProbeResult probeFor(const StreetAddress& k) const;
+
+    // Throws a runtime_error unless every slot's flag and name offsets are valid for the mapping
+    void validateSlots(const std::string& path, std::uint64_t stringsBytes) const;
+
+    // Where a slot's street/city name starts
+    const char* text(std::uint32_t offset) const;
+
+    // The address a slot holds
+    void keyOf(const Slot& slot, StreetAddress& key) const;
+
+    // Whether a slot holds this address
+    bool matches(const Slot& slot, const StreetAddress& k) const;
+
+    // Copies a string into the in-memory pool and returns its offset
+    std::uint32_t addExtraString(const std::string& s);
+
+    // Writes a snapshot of `capacity` slots; `slotAt(i, flag, key, value)` fills in slot i
+    template<typename SlotAt>
+    static void writeSnapshot(const std::string& path, int capacity, int probeSkip, int length,
+                              long long ordersProcessed, SlotAt slotAt);
+
+    // writeSnapshot for a HashTableClosed: `slotAt(i, key, value)` returns slot i's flag
+    // and fills in the key and value of a record
+    static void writeTable(const std::string& path, int capacity, int probeSkip, int length,
+                           long long ordersProcessed, const std::function<std::uint8_t(int, StreetAddress&, int&)>& slotAt);
+
+public:
+    // Maps a snapshot file. Throws a runtime_error if it can't be opened or isn't a valid snapshot
+    // (every slot is checked against the mapping, so a corrupt file can't be read out of bounds).
+    explicit MappedHashTable(const std::string& path);
+
+    // Unmaps the file; changes made since loading are lost unless they were saved
+    virtual ~MappedHashTable();
+
+    MappedHashTable(const MappedHashTable&) = delete;
+    MappedHashTable& operator=(const MappedHashTable&) = delete;
+
+    // dictionary interface methods
+    virtual void clear() override;
+    virtual int find(const StreetAddress&) const override;
+    virtual void insert(const StreetAddress&, const int&) override;
+    virtual void remove(const StreetAddress&) override;
+    virtual int size() const override;
+    virtual int slotCount() const override;
+    virtual void reserve(int capacity) override;
+    virtual void forEachInRange(int begin, int end,
+                                const std::function<void(const StreetAddress&, const int&)>& visit) const override;
+
+    // How many orders had been applied to the totals: a run restarted from this table should
+    // continue with the order after them
+    long long ordersProcessed() const;
+    void setOrdersProcessed(long long count);
+
+    // Writes the current contents (including changes since loading) to a new snapshot
+    void save(const std::string& path) const;
+
+    // Writes a hash table (with any allocator) that has had the first `ordersProcessed` orders
+    // applied to it to a snapshot file. Throws a runtime_error if the file can't be written.
+    template<typename Allocator>
+    static void save(const HashTableClosed<StreetAddress, int, Allocator>& table, const std::string& path,
+                     long long ordersProcessed);
+};
+
+template<typename Allocator>
+void MappedHashTable::save(const HashTableClosed<StreetAddress, int, Allocator>& table, const std::string& path,
+                           long long ordersProcessed) {
+    typedef typename HashTableClosed<StreetAddress, int, Allocator>::SlotType SlotType;
+    writeTable(path, table.capacity(), table.probeSkip(), table.size(), ordersProcessed,
+               [&table](int i, StreetAddress& key, int& value) -> std::uint8_t {
+        switch (table.slotType(i)) {
+            case SlotType::TOMBSTONE:
+                return TOMBSTONE;
+            case SlotType::RECORD:
+                key = table.keyAt(i);
+                value = table.valueAt(i);
+                return RECORD;
+            default:
+                return EMPTY;
+        }
+    });
+}
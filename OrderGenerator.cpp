@@ -0,0 +1,190 @@
+#include "OrderGenerator.hpp"
+#include "hashing.hpp"
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+namespace {
+    const char* const CITIES[] = {
+        "Alameda", "Antioch", "Berkeley", "Cupertino", "Daly City", "Dublin", "Emeryville",
+        "Fremont", "Hayward", "Livermore", "Los Gatos", "Menlo Park", "Millbrae", "Milpitas",
+        "Mountain View", "Oakland", "Palo Alto", "Pleasanton", "Redwood City", "San Bruno",
+        "San Jose", "Santa Clara", "Sunnyvale", "Union City", "Walnut Creek",
+    };
+    const int CITY_COUNT = sizeof(CITIES) / sizeof(CITIES[0]);
+
+    const char* const STREET_NAMES[] = {
+        "Cliff", "Oak", "Pine", "Maple", "Cedar", "Elm", "Park", "Lake", "Hill", "Main",
+        "Willow", "Spruce", "Sunset", "Mission", "Shoreline", "Bay", "Canyon", "Mesa",
+    };
+    const int STREET_NAME_COUNT = sizeof(STREET_NAMES) / sizeof(STREET_NAMES[0]);
+
+    const char* const STREET_SUFFIXES[] = {"St", "Ave", "Ln", "Blvd", "Dr", "Way", "Ct"};
+    const int STREET_SUFFIX_COUNT = sizeof(STREET_SUFFIXES) / sizeof(STREET_SUFFIXES[0]);
+
+    const int PRIME = 2147483647; // the modulus cs20::hash works in
+
+    // A fast, well-mixed 64-bit hash of a 64-bit value (splitmix64's finalizer)
+    unsigned long long mix(unsigned long long x) {
+        x += 0x9e3779b97f4a7c15ULL;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    std::string ordinal(int n) {
+        const char* suffix = "th";
+        if (n % 100 < 11 || n % 100 > 13) {
+            if (n % 10 == 1) {
+                suffix = "st";
+            } else if (n % 10 == 2) {
+                suffix = "nd";
+            } else if (n % 10 == 3) {
+                suffix = "rd";
+            }
+        }
+        return std::to_string(n) + suffix;
+    }
+
+    // A street name picked by `bits`: either numbered ("5th St") or named ("Cliff Ln")
+    std::string streetFor(unsigned long long bits) {
+        std::string suffix = STREET_SUFFIXES[bits % STREET_SUFFIX_COUNT];
+        bits /= STREET_SUFFIX_COUNT;
+        if (bits % 2 == 0) {
+            return ordinal(1 + static_cast<int>((bits / 2) % 60)) + " " + suffix;
+        }
+        return std::string(STREET_NAMES[(bits / 2) % STREET_NAME_COUNT]) + " " + suffix;
+    }
+}
+
+// ZipfSampler
+
+ZipfSampler::ZipfSampler(long long count, double exponent) : n(count), s(exponent) {
+    if (n < 1) {
+        throw std::invalid_argument("ZipfSampler: need at least one element");
+    }
+    if (s < 0) {
+        throw std::invalid_argument("ZipfSampler: exponent must not be negative");
+    }
+    hIntegralX1 = hIntegral(1.5) - 1;
+    hIntegralN = hIntegral(n + 0.5);
+    threshold = 2 - hIntegralInverse(hIntegral(2.5) - h(2));
+}
+
+double ZipfSampler::h(double x) const {
+    return std::exp(-s * std::log(x));
+}
+
+double ZipfSampler::hIntegral(double x) const {
+    // (x^(1-s) - 1) / (1-s), written so it stays accurate as s approaches 1
+    double logX = std::log(x);
+    double t = (1 - s) * logX;
+    double expm1OverT = std::abs(t) > 1e-8 ? std::expm1(t) / t : 1 + t / 2;
+    return expm1OverT * logX;
+}
+
+double ZipfSampler::hIntegralInverse(double x) const {
+    double t = x * (1 - s);
+    if (t < -1) {
+        t = -1; // only happens through rounding
+    }
+    double log1pOverT = std::abs(t) > 1e-8 ? std::log1p(t) / t : 1 - t / 2;
+    return std::exp(log1pOverT * x);
+}
+
+// OrderGenerator
+
+OrderGenerator::OrderGenerator(const OrderGeneratorConfig& c)
+    : config(c), rng(c.seed), zipf(c.distinctAddresses, c.zipfExponent), targetHash(0) {
+    if (config.distinctAddresses > MAX_DISTINCT_ADDRESSES) {
+        throw std::invalid_argument("OrderGenerator: at most " + std::to_string(MAX_DISTINCT_ADDRESSES)
+                                    + " distinct addresses");
+    }
+    if (config.colliding) {
+        // every other address is bent to hash like household 0 does before bending
+        config.colliding = false;
+        targetHash = cs20::hash(addressFor(0));
+        config.colliding = true;
+    }
+}
+
+StreetAddress OrderGenerator::addressFor(long long index) const {
+    index %= MAX_DISTINCT_ADDRESSES;
+    if (index < 0) {
+        index += MAX_DISTINCT_ADDRESSES;
+    }
+    unsigned long long bits = mix(config.seed ^ mix(static_cast<unsigned long long>(index)));
+    StreetAddress sa;
+    sa.city = CITIES[bits % CITY_COUNT];
+    sa.street = streetFor(bits / CITY_COUNT);
+
+    if (!config.colliding) {
+        // number and zip together encode the index, so households 0 .. MAX_DISTINCT_ADDRESSES - 1
+        // never share an address
+        sa.number = 1 + static_cast<int>(index % 9999);
+        sa.zip = 10000 + static_cast<int>((index / 9999) % 90000);
+        return sa;
+    }
+
+    // cs20::hash ends with (h * 31 + zip) % PRIME, so once the rest of the address is fixed
+    // we can solve for the zip that lands on targetHash. The number (at most MAX_DISTINCT_ADDRESSES,
+    // which fits an int) keeps addresses distinct. When that sum would overflow, try another street.
+    sa.number = 1 + static_cast<int>(index);
+    for (unsigned long long attempt = 1; ; attempt++) {
+        sa.zip = 0;
+        long long withoutZip = cs20::hash(sa);
+        sa.zip = static_cast<int>(((targetHash - withoutZip) % PRIME + PRIME) % PRIME);
+        if (cs20::hash(sa) == targetHash) {
+            return sa;
+        }
+        sa.street = streetFor(mix(bits + attempt));
+    }
+}
+
+double OrderGenerator::uniform() {
+    return (rng() >> 11) * (1.0 / 9007199254740992.0); // 53 random bits
+}
+
+int OrderGenerator::nextKitCount() {
+    // about 16% order 1, 33% order 2, 33% order 3, 16% order 4 and 2% ask for 5-9
+    unsigned long long r = rng() % 1000;
+    if (r < 164) {
+        return 1;
+    } else if (r < 491) {
+        return 2;
+    } else if (r < 818) {
+        return 3;
+    } else if (r < 980) {
+        return 4;
+    }
+    return 5 + static_cast<int>(r % 5);
+}
+
+COVIDTestOrder OrderGenerator::next() {
+    long long household;
+    if (config.zipfExponent == 0) {
+        household = static_cast<long long>(rng() % static_cast<unsigned long long>(config.distinctAddresses));
+    } else {
+        auto draw = [this] { return uniform(); };
+        household = zipf.sample(draw) - 1;
+    }
+    StreetAddress sa = addressFor(household);
+    return COVIDTestOrder(sa, nextKitCount());
+}
+
+std::vector<COVIDTestOrder> OrderGenerator::generate(long long count) {
+    std::vector<COVIDTestOrder> orders;
+    orders.reserve(count);
+    for (long long i = 0; i < count; i++) {
+        orders.push_back(next());
+    }
+    return orders;
+}
+
+void OrderGenerator::writeCsv(std::ostream& out, long long count) {
+    for (long long i = 0; i < count; i++) {
+        COVIDTestOrder order = next();
+        out << order.sa.number << ',' << order.sa.street << ',' << order.sa.city << ','
+            << order.sa.zip << ',' << order.numOrdered << '\n';
+    }
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "COVIDTestOrder.hpp"
+#include <ostream>
+#include <random>
+#include <vector>
+
+// Settings for OrderGenerator
+struct OrderGeneratorConfig {
+    long long distinctAddresses; // how many different households can place orders
+    double zipfExponent;         // how skewed repeat orders are: 0 = uniform, 1 or more = a few hot addresses dominate
+    bool colliding;              // make every address produce the same cs20::hash value
+    unsigned long long seed;     // same seed and settings, same orders, on every platform
+
+    OrderGeneratorConfig(long long distinct = 100000, double zipf = 0, bool collide = false,
+                         unsigned long long s = 1)
+        : distinctAddresses(distinct), zipfExponent(zipf), colliding(collide), seed(s) {}
+};
+
+// Draws integers in [1, n] with P(k) proportional to 1 / k^s,
+// in constant time per sample (rejection-inversion, Hormann & Derflinger 1996)
+class ZipfSampler {
+private:
+    long long n;
+    double s;
+    double hIntegralX1;
+    double hIntegralN;
+    double threshold;
+
+    double h(double x) const;
+    double hIntegral(double x) const;
+    double hIntegralInverse(double x) const;
+
+public:
+    ZipfSampler(long long n, double s);
+
+    // `uniform` returns doubles in [0, 1)
+    template<typename Uniform>
+    long long sample(Uniform& uniform) const;
+};
+
+// Produces a deterministic stream of synthetic orders, one at a time, so that the number
+// of orders is not limited by memory. Households are numbered 0 .. distinctAddresses - 1,
+// each number always maps to the same StreetAddress, and which household orders next is
+// drawn from a Zipf distribution over those numbers (household 0 being the hottest).
+class OrderGenerator {
+public:
+    // How many households have addresses of their own: number (1 .. 9999) and zip (10000 .. 99999)
+    // together encode the household, so larger indexes would wrap around onto smaller ones
+    static const long long MAX_DISTINCT_ADDRESSES = 9999LL * 90000;
+
+private:
+    OrderGeneratorConfig config;
+    std::mt19937_64 rng;
+    ZipfSampler zipf;
+    int targetHash; // the hash every address collides on, in colliding mode
+
+    // A uniformly distributed double in [0, 1)
+    double uniform();
+
+    // How many kits the next order asks for (roughly matches data/orders100k.csv)
+    int nextKitCount();
+
+public:
+    // Throws an invalid_argument if distinctAddresses is not in 1 .. MAX_DISTINCT_ADDRESSES
+    OrderGenerator(const OrderGeneratorConfig& config);
+
+    // The address of household number `index`, taken modulo MAX_DISTINCT_ADDRESSES
+    StreetAddress addressFor(long long index) const;
+
+    // The next order in the stream
+    COVIDTestOrder next();
+
+    // The next `count` orders in the stream
+    std::vector<COVIDTestOrder> generate(long long count);
+
+    // Writes the next `count` orders in the data/orders100k.csv format
+    void writeCsv(std::ostream& out, long long count);
+};
+
+// implementation
+
+template<typename Uniform>
+long long ZipfSampler::sample(Uniform& uniform) const {
+    while (true) {
+        double u = hIntegralN + uniform() * (hIntegralX1 - hIntegralN);
+        double x = hIntegralInverse(u);
+        long long k = static_cast<long long>(x + 0.5);
+        if (k < 1) {
+            k = 1;
+        } else if (k > n) {
+            k = n;
+        }
+        if (k - x <= threshold || u >= hIntegral(k + 0.5) - h(k)) {
+            return k;
+        }
+    }
+}
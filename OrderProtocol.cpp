@@ -0,0 +1,129 @@
+#include "OrderProtocol.hpp"
+#include <cstdint>
+#include <stdexcept>
+
+namespace {
+    void appendLittleEndian(std::string& out, std::uint32_t value, int bytes) {
+        for (int i = 0; i < bytes; i++) {
+            out.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+        }
+    }
+
+    std::uint32_t readLittleEndian(const char* data, int bytes) {
+        std::uint32_t value = 0;
+        for (int i = bytes - 1; i >= 0; i--) {
+            value = (value << 8) | static_cast<unsigned char>(data[i]);
+        }
+        return value;
+    }
+
+    // Reads fields from a payload in order, checking that each one fits
+    class Reader {
+    private:
+        const char* data;
+        std::size_t left;
+
+        const char* take(std::size_t n) {
+            if (n > left) {
+                throw std::runtime_error("OrderProtocol: error, message is too short");
+            }
+            const char* field = data;
+            data += n;
+            left -= n;
+            return field;
+        }
+
+    public:
+        Reader(const char* d, std::size_t n) : data(d), left(n) {}
+
+        int int32() {
+            return static_cast<std::int32_t>(readLittleEndian(take(4), 4));
+        }
+
+        std::string string16() {
+            std::size_t length = readLittleEndian(take(2), 2);
+            return std::string(take(length), length);
+        }
+
+        unsigned char byte() {
+            return static_cast<unsigned char>(*take(1));
+        }
+
+        bool done() const {
+            return left == 0;
+        }
+    };
+}
+
+void OrderProtocol::encodeRequest(const COVIDTestOrder& order, std::string& out) {
+    const StreetAddress& sa = order.sa;
+    if (sa.street.size() > 0xffff || sa.city.size() > 0xffff) {
+        throw std::runtime_error("OrderProtocol: error, street or city name is too long");
+    }
+    std::size_t payload = 4 + 4 + 4 + 2 + sa.street.size() + 2 + sa.city.size();
+    appendLittleEndian(out, static_cast<std::uint32_t>(payload), 4);
+    appendLittleEndian(out, static_cast<std::uint32_t>(sa.number), 4);
+    appendLittleEndian(out, static_cast<std::uint32_t>(sa.zip), 4);
+    appendLittleEndian(out, static_cast<std::uint32_t>(order.numOrdered), 4);
+    appendLittleEndian(out, static_cast<std::uint32_t>(sa.street.size()), 2);
+    out += sa.street;
+    appendLittleEndian(out, static_cast<std::uint32_t>(sa.city.size()), 2);
+    out += sa.city;
+}
+
+void OrderProtocol::encodeResponse(bool accepted, int total, std::string& out) {
+    appendLittleEndian(out, static_cast<std::uint32_t>(RESPONSE_PAYLOAD_BYTES), 4);
+    out.push_back(accepted ? 1 : 0);
+    appendLittleEndian(out, static_cast<std::uint32_t>(total), 4);
+}
+
+void OrderProtocol::encodeError(const std::string& message, std::string& out) {
+    std::string text = message.substr(0, MAX_PAYLOAD_BYTES - 1);
+    appendLittleEndian(out, static_cast<std::uint32_t>(1 + text.size()), 4);
+    out.push_back(static_cast<char>(ERROR_STATUS));
+    out += text;
+}
+
+std::size_t OrderProtocol::nextMessage(const char* data, std::size_t bytes, const char*& payload,
+                                       std::size_t& payloadBytes) {
+    if (bytes < HEADER_BYTES) {
+        return 0;
+    }
+    std::size_t length = readLittleEndian(data, 4);
+    if (length > MAX_PAYLOAD_BYTES) {
+        throw std::runtime_error("OrderProtocol: error, message is too long");
+    }
+    if (bytes < HEADER_BYTES + length) {
+        return 0;
+    }
+    payload = data + HEADER_BYTES;
+    payloadBytes = length;
+    return HEADER_BYTES + length;
+}
+
+COVIDTestOrder OrderProtocol::decodeRequest(const char* payload, std::size_t payloadBytes) {
+    Reader reader(payload, payloadBytes);
+    COVIDTestOrder order;
+    order.sa.number = reader.int32();
+    order.sa.zip = reader.int32();
+    order.numOrdered = reader.int32();
+    order.sa.street = reader.string16();
+    order.sa.city = reader.string16();
+    if (!reader.done()) {
+        throw std::runtime_error("OrderProtocol: error, request has trailing bytes");
+    }
+    return order;
+}
+
+void OrderProtocol::decodeResponse(const char* payload, std::size_t payloadBytes, bool& accepted, int& total) {
+    Reader reader(payload, payloadBytes);
+    unsigned char status = reader.byte();
+    if (status == ERROR_STATUS) {
+        throw std::runtime_error("OrderProtocol: server error: " + std::string(payload + 1, payloadBytes - 1));
+    }
+    accepted = status != 0;
+    total = reader.int32();
+    if (!reader.done()) {
+        throw std::runtime_error("OrderProtocol: error, response has trailing bytes");
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "COVIDTestOrder.hpp"
+#include <cstddef>
+#include <string>
+
+// The wire format between OrderServer and its clients.
+// Every message is a little-endian uint32 payload length followed by the payload.
+//
+// Request payload:  int32 number, int32 zip, int32 kits ordered,
+//                   uint16 street length, street bytes, uint16 city length, city bytes
+// Response payload: uint8 accepted (0 or 1), int32 household total
+//                   (the new total if accepted, what it already had if rejected)
+// Error payload:    uint8 2, then a message; the server sends it in place of the response to a
+//                   request it can't answer, and closes the connection after it
+//
+// Clients may send any number of requests before reading responses (pipelining);
+// responses on a connection always come back in request order.
+namespace OrderProtocol {
+    const std::size_t HEADER_BYTES = 4;
+    const std::size_t RESPONSE_PAYLOAD_BYTES = 5;
+    const std::size_t MAX_PAYLOAD_BYTES = 1 << 16; // larger lengths mean the stream is garbage
+    const unsigned char ERROR_STATUS = 2;
+
+    // Appends a request for `order` to `out`
+    void encodeRequest(const COVIDTestOrder& order, std::string& out);
+
+    // Appends a response to `out`
+    void encodeResponse(bool accepted, int total, std::string& out);
+
+    // Appends an error carrying `message` (cut to fit a payload) to `out`
+    void encodeError(const std::string& message, std::string& out);
+
+    // If `data` starts with a complete message, returns its total size (header included)
+    // and points `payload` / `payloadBytes` at its payload; returns 0 if more bytes are needed.
+    // Throws a runtime_error if the length is larger than MAX_PAYLOAD_BYTES.
+    std::size_t nextMessage(const char* data, std::size_t bytes, const char*& payload, std::size_t& payloadBytes);
+
+    // Parses a request payload. Throws a runtime_error if it is malformed.
+    COVIDTestOrder decodeRequest(const char* payload, std::size_t payloadBytes);
+
+    // Parses a response payload. Throws a runtime_error if it is malformed or an error
+    // (with the server's message).
+    void decodeResponse(const char* payload, std::size_t payloadBytes, bool& accepted, int& total);
+}
@@ -0,0 +1,263 @@
+#include "OrderServer.hpp"
+#include "OrderProtocol.hpp"
+#include "Simulator.hpp"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+    const std::size_t READ_CHUNK = 64 * 1024;
+    const std::size_t MAX_PENDING_OUTPUT = 1 << 20; // stop reading from a client that doesn't read its answers
+    const int MAX_EVENTS = 64;
+    const int POLL_TIMEOUT_MS = 200; // how often `stop` is checked when idle
+
+    std::runtime_error failure(const std::string& what) {
+        return std::runtime_error("OrderServer: " + what + ": " + std::strerror(errno));
+    }
+
+    void setNonBlocking(int fd) {
+        int flags = fcntl(fd, F_GETFL, 0);
+        fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    }
+}
+
+OrderServer::OrderServer(const std::string& socketPath, Dictionary<StreetAddress, int>* d)
+    : path(socketPath), dict(d), listenFd(-1), epollFd(-1), served(0), batches(0) {
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("OrderServer: socket path is too long: " + path);
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    // a socket file left behind by a previous server would make bind fail
+    struct stat info;
+    if (stat(path.c_str(), &info) == 0 && S_ISSOCK(info.st_mode)) {
+        unlink(path.c_str());
+    }
+
+    listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd < 0) {
+        throw failure("can't create socket");
+    }
+    if (bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+        || listen(listenFd, SOMAXCONN) != 0) {
+        std::runtime_error error = failure("can't listen on " + path);
+        close(listenFd);
+        throw error;
+    }
+    setNonBlocking(listenFd);
+
+    epollFd = epoll_create1(0);
+    if (epollFd < 0) {
+        std::runtime_error error = failure("can't create epoll instance");
+        close(listenFd);
+        unlink(path.c_str());
+        throw error;
+    }
+    epoll_event event;
+    std::memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = listenFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event);
+}
+
+OrderServer::~OrderServer() {
+    for (auto& entry : connections) {
+        close(entry.first);
+    }
+    close(epollFd);
+    close(listenFd);
+    unlink(path.c_str());
+}
+
+void OrderServer::run(const volatile std::sig_atomic_t& stop) {
+    epoll_event events[MAX_EVENTS];
+    while (!stop) {
+        int ready = epoll_wait(epollFd, events, MAX_EVENTS, POLL_TIMEOUT_MS);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue; // probably the signal that sets `stop`
+            }
+            throw failure("epoll_wait failed");
+        }
+        for (int i = 0; i < ready; i++) {
+            int fd = events[i].data.fd;
+            if (fd == listenFd) {
+                acceptAll();
+                continue;
+            }
+            auto found = connections.find(fd);
+            if (found == connections.end()) {
+                continue;
+            }
+            Connection& c = found->second;
+            bool keep = true;
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                keep = handleInput(c);
+            }
+            if (keep && (events[i].events & EPOLLOUT)) {
+                keep = handleOutput(c);
+            }
+            if (keep) {
+                updateInterest(c);
+            } else {
+                closeConnection(fd);
+            }
+        }
+    }
+}
+
+void OrderServer::acceptAll() {
+    while (true) {
+        int fd = accept(listenFd, nullptr, nullptr);
+        if (fd < 0) {
+            return; // EAGAIN: nothing more to accept (anything else: try again on the next event)
+        }
+        addConnection(fd);
+    }
+}
+
+void OrderServer::adopt(int fd) {
+    addConnection(fd);
+}
+
+void OrderServer::addConnection(int fd) {
+    setNonBlocking(fd);
+    Connection& c = connections[fd];
+    c.fd = fd;
+    c.outStart = 0;
+    c.reading = true;
+    c.writing = false;
+    c.closing = false;
+
+    epoll_event event;
+    std::memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+}
+
+bool OrderServer::handleInput(Connection& c) {
+    // drain the socket first, so everything that is already here is answered as one batch;
+    // answering as we go lets us stop once a client that isn't reading has enough output pending
+    char buffer[READ_CHUNK];
+    long long answered = 0;
+    while (!c.closing && c.out.size() - c.outStart < MAX_PENDING_OUTPUT) {
+        ssize_t n = read(c.fd, buffer, sizeof(buffer));
+        if (n > 0) {
+            c.in.append(buffer, static_cast<std::size_t>(n));
+            answered += answerRequests(c);
+            if (static_cast<std::size_t>(n) < sizeof(buffer)) {
+                break;
+            }
+        } else if (n == 0) {
+            c.closing = true; // the client closed its end; answer what it sent, then close
+            break;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+        } else {
+            return false;
+        }
+    }
+
+    if (answered > 0) {
+        batches++;
+    }
+    return handleOutput(c);
+}
+
+long long OrderServer::answerRequests(Connection& c) {
+    std::size_t consumed = 0;
+    long long answered = 0;
+    try {
+        const char* payload;
+        std::size_t payloadBytes;
+        std::size_t size;
+        while (c.out.size() - c.outStart < MAX_PENDING_OUTPUT &&
+               (size = OrderProtocol::nextMessage(c.in.data() + consumed, c.in.size() - consumed,
+                                                  payload, payloadBytes)) != 0) {
+            COVIDTestOrder order = OrderProtocol::decodeRequest(payload, payloadBytes);
+            int total = 0;
+            bool accepted = processOrder(dict, order, total);
+            OrderProtocol::encodeResponse(accepted, total, c.out);
+            consumed += size;
+            answered++;
+        }
+    } catch (const std::exception& e) {
+        // a malformed request, or the table is full: the requests before it still get their answers,
+        // then the client is told why and the connection closes
+        OrderProtocol::encodeError(e.what(), c.out);
+        c.closing = true;
+        consumed = c.in.size();
+    }
+    c.in.erase(0, consumed);
+    served += answered;
+    return answered;
+}
+
+bool OrderServer::handleOutput(Connection& c) {
+    for (;;) {
+        while (c.outStart < c.out.size()) {
+            ssize_t n = write(c.fd, c.out.data() + c.outStart, c.out.size() - c.outStart);
+            if (n > 0) {
+                c.outStart += static_cast<std::size_t>(n);
+            } else if (n < 0 && errno == EINTR) {
+                continue;
+            } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                return true; // the rest goes out when epoll says the socket is writable
+            } else {
+                return false;
+            }
+        }
+        c.out.clear();
+        c.outStart = 0;
+        // requests held back while too much output was pending can be answered now
+        long long answered = answerRequests(c);
+        if (answered == 0 && c.out.empty()) {
+            break;
+        }
+        if (answered > 0) {
+            batches++;
+        }
+    }
+    return !c.closing;
+}
+
+void OrderServer::updateInterest(Connection& c) {
+    bool wantWrite = c.outStart < c.out.size();
+    bool wantRead = !c.closing && c.out.size() - c.outStart < MAX_PENDING_OUTPUT;
+    if (wantWrite == c.writing && wantRead == c.reading) {
+        return;
+    }
+    c.writing = wantWrite;
+    c.reading = wantRead;
+    epoll_event event;
+    std::memset(&event, 0, sizeof(event));
+    event.events = (wantRead ? static_cast<unsigned>(EPOLLIN) : 0u) | (wantWrite ? static_cast<unsigned>(EPOLLOUT) : 0u);
+    event.data.fd = c.fd;
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, c.fd, &event);
+}
+
+void OrderServer::closeConnection(int fd) {
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    connections.erase(fd);
+}
+
+long long OrderServer::requestsServed() const {
+    return served;
+}
+
+long long OrderServer::batchesServed() const {
+    return batches;
+}
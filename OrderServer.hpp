@@ -0,0 +1,82 @@
+#pragma once
+
+#include "Dictionary.hpp"
+#include "StreetAddress.hpp"
+#include <csignal>
+#include <string>
+#include <unordered_map>
+
+// Serves the per-household cap to clients over a Unix domain socket (see OrderProtocol for the format).
+//
+// One thread, one epoll loop: every readable connection is drained in one go, every complete
+// request in what arrived is answered against the same dictionary, and all of those responses
+// go out in a single write. That way pipelined clients get batching for free.
+// A client that doesn't read its answers is only read from (and answered) until about a megabyte
+// of output is pending; the rest of its requests wait until that has been written.
+// A client that shuts down its end, or sends a request that can't be answered, still gets every
+// answer due (and then an error) before the connection is closed.
+class OrderServer {
+private:
+    // One client and its buffered input and output
+    struct Connection {
+        int fd;
+        std::string in;          // bytes received but not yet parsed
+        std::string out;         // responses not yet written
+        std::size_t outStart;    // how much of `out` has been written
+        bool reading;            // whether we are waiting for input (off while too much output is pending)
+        bool writing;            // whether we are waiting for the socket to become writable
+        bool closing;            // no more input will be read: close once `out` has been written
+    };
+
+    std::string path;
+    Dictionary<StreetAddress, int>* dict;
+    int listenFd;
+    int epollFd;
+    std::unordered_map<int, Connection> connections;
+    long long served;   // requests answered
+    long long batches;  // reads that answered at least one request
+
+    // Accepts every pending connection
+    void acceptAll();
+
+    // Starts serving a connected socket
+    void addConnection(int fd);
+
+    // Reads what is available on a connection (until too much output is pending) and answers
+    // the complete requests in it. Returns false if the connection should be closed.
+    bool handleInput(Connection& c);
+
+    // Answers complete requests from `in` until too much output is pending. Returns how many it answered.
+    long long answerRequests(Connection& c);
+
+    // Writes as much pending output as the socket takes, answering requests that were held back
+    // once there is room. Returns false if the connection should be closed (including once a
+    // closing connection has nothing left to answer or write).
+    bool handleOutput(Connection& c);
+
+    // Tells epoll which events we want for a connection
+    void updateInterest(Connection& c);
+
+    void closeConnection(int fd);
+
+public:
+    // Creates the socket at `socketPath` (replacing a stale one) and starts listening.
+    // Throws a runtime_error if that fails.
+    OrderServer(const std::string& socketPath, Dictionary<StreetAddress, int>* dict);
+
+    // Closes every connection and removes the socket file
+    ~OrderServer();
+
+    OrderServer(const OrderServer&) = delete;
+    OrderServer& operator=(const OrderServer&) = delete;
+
+    // Serves an already-connected socket (e.g. one end of a socketpair) alongside the accepted ones;
+    // the server closes it when the client is done
+    void adopt(int fd);
+
+    // Serves clients until `stop` becomes non-zero (e.g. from a signal handler)
+    void run(const volatile std::sig_atomic_t& stop);
+
+    long long requestsServed() const;
+    long long batchesServed() const;
+};
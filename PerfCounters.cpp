@@ -0,0 +1,188 @@
+#include "PerfCounters.hpp"
+#include <cstring>
+#include <iomanip>
+#include <sys/resource.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+#ifdef __linux__
+    // Opens an event for this thread (any CPU). A grouped event is a member of `leader`'s group,
+    // or leads a new group if `leader` is -1; the whole group is read through its leader.
+    int openEvent(unsigned int type, unsigned long long config, bool grouped, int leader = -1) {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = leader == -1 ? 1 : 0; // members follow their leader
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        if (grouped) {
+            attr.read_format |= PERF_FORMAT_GROUP;
+        }
+        return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0));
+    }
+
+    // Scales a count for the time its event (or group) actually spent on the PMU
+    long long scaled(unsigned long long count, unsigned long long enabled, unsigned long long running) {
+        if (running == 0) {
+            return 0; // never got onto the PMU
+        }
+        return static_cast<long long>(static_cast<double>(count) * enabled / running);
+    }
+#endif
+
+    double perOrder(long long count, long long orders) {
+        return orders == 0 ? 0 : static_cast<double>(count) / orders;
+    }
+}
+
+PerfCounters::PerfCounters() : groupSize(0), rusageFaults(0) {
+    for (int i = 0; i < EVENT_COUNT; i++) {
+        fds[i] = -1;
+        values[i] = 0;
+    }
+#ifdef __linux__
+    // the hardware events are one group led by CYCLES, so the PMU schedules them together and
+    // every ratio between them (IPC above all) comes from the same stretch of execution
+    fds[CYCLES] = openEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, true);
+    if (fds[CYCLES] != -1) {
+        groupOrder[groupSize++] = CYCLES;
+        const Event members[] = {INSTRUCTIONS, CACHE_MISSES, BRANCH_MISSES, DTLB_MISSES};
+        const unsigned long long configs[] = {
+            PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES,
+            PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+        };
+        for (int i = 0; i < 4; i++) {
+            unsigned int type = members[i] == DTLB_MISSES ? PERF_TYPE_HW_CACHE : PERF_TYPE_HARDWARE;
+            fds[members[i]] = openEvent(type, configs[i], true, fds[CYCLES]);
+            if (fds[members[i]] != -1) {
+                groupOrder[groupSize++] = members[i];
+            }
+        }
+    }
+    // software events are never multiplexed, so they are counted on their own
+    fds[PAGE_FAULTS] = openEvent(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS, false);
+    fds[TASK_CLOCK] = openEvent(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK, false);
+#endif
+}
+
+PerfCounters::~PerfCounters() {
+#ifdef __linux__
+    for (int i = 0; i < EVENT_COUNT; i++) {
+        if (fds[i] != -1) {
+            close(fds[i]);
+        }
+    }
+#endif
+}
+
+void PerfCounters::start() {
+    // like Timer::start, the counters are switched on as the very last thing
+    rusageFaults = currentRusageFaults();
+#ifdef __linux__
+    for (int e : {PAGE_FAULTS, TASK_CLOCK}) {
+        if (fds[e] != -1) {
+            ioctl(fds[e], PERF_EVENT_IOC_RESET, 0);
+            ioctl(fds[e], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+    if (groupSize > 0) {
+        ioctl(fds[CYCLES], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(fds[CYCLES], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+#endif
+}
+
+void PerfCounters::stop() {
+#ifdef __linux__
+    if (groupSize > 0) {
+        ioctl(fds[CYCLES], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    }
+    for (int e : {PAGE_FAULTS, TASK_CLOCK}) {
+        if (fds[e] != -1) {
+            ioctl(fds[e], PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+    for (int i = 0; i < EVENT_COUNT; i++) {
+        values[i] = 0;
+    }
+
+    if (groupSize > 0) {
+        // number of events, time enabled, time running, then one value per event in the order opened
+        unsigned long long data[3 + EVENT_COUNT];
+        ssize_t wanted = static_cast<ssize_t>((3 + groupSize) * sizeof(data[0]));
+        if (::read(fds[CYCLES], data, sizeof(data)) == wanted && data[0] == static_cast<unsigned long long>(groupSize)) {
+            for (int i = 0; i < groupSize; i++) {
+                values[groupOrder[i]] = scaled(data[3 + i], data[1], data[2]);
+            }
+        }
+    }
+    for (int e : {PAGE_FAULTS, TASK_CLOCK}) {
+        // value, time enabled, time running
+        unsigned long long data[3];
+        if (fds[e] != -1 && ::read(fds[e], data, sizeof(data)) == static_cast<ssize_t>(sizeof(data))) {
+            values[e] = scaled(data[0], data[1], data[2]);
+        }
+    }
+#endif
+    if (fds[PAGE_FAULTS] == -1) {
+        values[PAGE_FAULTS] = currentRusageFaults() - rusageFaults;
+    }
+}
+
+bool PerfCounters::available(Event e) const {
+    return e == PAGE_FAULTS || fds[e] != -1;
+}
+
+bool PerfCounters::hasHardware() const {
+    return available(CYCLES) && available(INSTRUCTIONS);
+}
+
+long long PerfCounters::read(Event e) const {
+    return values[e];
+}
+
+void PerfCounters::print(std::ostream& out, long long orders) const {
+    // three decimals for this line only; the caller's stream formatting is restored at the end
+    std::ios::fmtflags savedFlags = out.flags();
+    std::streamsize savedPrecision = out.precision();
+    out << std::fixed << std::setprecision(3);
+    if (hasHardware()) {
+        double ipc = values[CYCLES] == 0 ? 0 : static_cast<double>(values[INSTRUCTIONS]) / values[CYCLES];
+        out << "IPC " << ipc
+            << ", " << perOrder(values[CYCLES], orders) << " cycles/order";
+        if (available(CACHE_MISSES)) {
+            out << ", " << perOrder(values[CACHE_MISSES], orders) << " cache misses/order";
+        }
+        if (available(BRANCH_MISSES)) {
+            out << ", " << perOrder(values[BRANCH_MISSES], orders) << " branch misses/order";
+        }
+        if (available(DTLB_MISSES)) {
+            out << ", " << perOrder(values[DTLB_MISSES], orders) << " dTLB misses/order";
+        }
+    } else {
+        out << "no hardware counters";
+        if (available(TASK_CLOCK)) {
+            out << ", task-clock " << values[TASK_CLOCK] / 1e6 << " ms";
+        }
+    }
+    out << ", " << perOrder(values[PAGE_FAULTS], orders) << " page faults/order";
+    out.flags(savedFlags);
+    out.precision(savedPrecision);
+}
+
+long long PerfCounters::currentRusageFaults() {
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+    return usage.ru_minflt + usage.ru_majflt;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <ostream>
+
+// Counts what the CPU and the kernel did between `start` and `stop`, using Linux perf_event_open.
+// Hardware events (cycles, instructions, cache, branch and dTLB misses) need a PMU the kernel lets us use;
+// when it doesn't (VMs, containers, non-Linux), the software events still work,
+// and if perf_event_open isn't usable at all, page faults come from getrusage instead.
+// The hardware events are opened as one group, so they are always on the PMU at the same time
+// and their ratios are consistent even when the kernel multiplexes them with other users' events.
+// Only this thread is counted, and only in user space.
+class PerfCounters {
+public:
+    // The events we try to count
+    enum Event {
+        CYCLES,
+        INSTRUCTIONS,
+        CACHE_MISSES,
+        BRANCH_MISSES,
+        DTLB_MISSES, // data TLB misses on loads
+        PAGE_FAULTS,
+        TASK_CLOCK,  // nanoseconds this thread was on a CPU
+        EVENT_COUNT, // not an event: how many there are
+    };
+
+private:
+    int fds[EVENT_COUNT];          // perf file descriptors, -1 if the event couldn't be opened
+    Event groupOrder[EVENT_COUNT]; // the hardware group's events, leader (CYCLES) first, in the order opened
+    int groupSize;                 // how many events the group has, 0 if it couldn't be opened
+    long long values[EVENT_COUNT]; // counts from the last start/stop pair, scaled for multiplexing
+    long long rusageFaults;        // page faults at `start`, when PAGE_FAULTS comes from getrusage
+
+    // Reads the total page faults of this process from getrusage
+    static long long currentRusageFaults();
+
+public:
+    PerfCounters();
+    ~PerfCounters();
+
+    // Counters own file descriptors, so they can't be copied
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    // Resets and starts every counter
+    void start();
+
+    // Stops every counter and stores its value
+    void stop();
+
+    // Whether an event is being counted (PAGE_FAULTS always is)
+    bool available(Event e) const;
+
+    // Whether the hardware events (cycles and instructions at least) are being counted
+    bool hasHardware() const;
+
+    // The count of an event from the last start/stop pair, or 0 if it isn't available
+    long long read(Event e) const;
+
+    // Prints IPC and per-order miss/fault rates for a run that processed `orders` orders,
+    // or the software counters if that's all we have
+    void print(std::ostream& out, long long orders) const;
+};
@@ -1,52 +1,112 @@
 #include "Simulator.hpp"
-#include <iostream>
+#include "Timer.hpp"
+#include <algorithm>
+#include <climits>
 #include <stdexcept>
 
-void runSimulator(const std::vector<COVIDTestOrder>& orders, Dictionary<StreetAddress, int>* dict, bool analyze) {
-    const int MAX_KITS_PER_ADDRESS = 4;
-    int orderNum = 1;
+namespace {
+    // the dictionary key for an order's address: the address itself, or an inline copy of it
+    const StreetAddress& keyFor(const StreetAddress& address, const StreetAddress*) {
+        return address;
+    }
+
+    AddressKey keyFor(const StreetAddress& address, const AddressKey*) {
+        return AddressKey(address);
+    }
+
+    // Stores a household's total. If the dictionary is full (say it was sized from an estimate of the
+    // households that fell short), it is grown to twice its slots and the insert tried once more;
+    // a full dictionary's slotCount() is its capacity, whatever kind it is. (A full HashTableClosed
+    // refuses even updates, which would otherwise land in processOrderWith's first-order path.)
+    template<typename Key>
+    void storeTotal(Dictionary<Key, int>* dict, const Key& addr, int total) {
+        try {
+            dict->insert(addr, total);
+        } catch (const std::runtime_error&) {
+            long long grown = 2LL * std::max(dict->slotCount(), 1);
+            dict->reserve(static_cast<int>(std::min<long long>(grown, INT_MAX)));
+            dict->insert(addr, total);
+        }
+    }
+}
+
+// the order handling shared by both key types
+template<typename Key>
+bool processOrderWith(Dictionary<Key, int>* dict, const COVIDTestOrder& order, int& totalOrdered) {
+    const Key& addr = keyFor(order.sa, static_cast<const Key*>(nullptr));
+    int numOrdered = order.numOrdered;
+    bool accept = false;
+
+    try {
+        // check for previous orders at the same address
+        int previousOrdered = dict->find(addr);
+        totalOrdered = previousOrdered + numOrdered;
+        if (totalOrdered <= MAX_KITS_PER_ADDRESS) {
+            accept = true;
+            storeTotal(dict, addr, totalOrdered); // update value if order is accepted
+        } else {
+            totalOrdered = previousOrdered; // keep previous total if limit exceeded
+        }
+    } catch (const std::exception& e) {
+        // key not found, so this is the first order for this address
+        if (numOrdered <= MAX_KITS_PER_ADDRESS) {
+            accept = true;
+            totalOrdered = numOrdered;
+            storeTotal(dict, addr, totalOrdered); // add first-time order
+        } else {
+            totalOrdered = 0; // too many kits ordered initially, no insertion
+        }
+    }
+    return accept;
+}
+
+template<typename Key>
+void runSimulatorWith(const std::vector<COVIDTestOrder>& orders, Dictionary<Key, int>* dict,
+                      DecisionLog* analyzeLog, LatencyHistogram* latencies, OrderClock* clock,
+                      int firstOrderNum) {
+    int orderNum = firstOrderNum;
+    // only used when latencies are recorded
+    Timer orderTimer(latencies ? Timer::Clock::TSC : Timer::Clock::STEADY);
 
     for (const auto& order : orders) {
-        const StreetAddress& addr = order.sa;
-        int numOrdered = order.numOrdered;
+        if (latencies) {
+            orderTimer.start();
+        }
+        if (clock) {
+            clock->advance(orderNum);
+        }
         int totalOrdered = 0;
-        bool accept = false;
+        bool accept = processOrderWith(dict, order, totalOrdered);
 
-        try {
-            // check for previous orders at the same address
-            int previousOrdered = dict->find(addr);
-            totalOrdered = previousOrdered + numOrdered;
-            if (totalOrdered <= MAX_KITS_PER_ADDRESS) {
-                accept = true;
-                dict->insert(addr, totalOrdered); // update value if order is accepted
-            } else {
-                totalOrdered = previousOrdered; // keep previous total if limit exceeded
-            }
-        } catch (const std::exception& e) {
-            // key not found, so this is the first order for this address
-            if (numOrdered <= MAX_KITS_PER_ADDRESS) {
-                accept = true;
-                totalOrdered = numOrdered;
-                dict->insert(addr, totalOrdered); // add first-time order
-            } else {
-                totalOrdered = 0; // too many kits ordered initially, no insertion
-            }
+        if (latencies) {
+            orderTimer.stop();
+            latencies->record(orderTimer.readNanos());
         }
 
-        // if analyze mode is on, print the result of each order processing
-        if (analyze) {
-            if (accept) {
-                // print accepted order details
-                std::cout << "#" << orderNum << " accepted: " << numOrdered << " kits to "
-                          << addr.number << " " << addr.street << ", "
-                          << addr.city << " " << addr.zip << " (" << totalOrdered << " total)" << std::endl;
-            } else {
-                // print rejected order details
-                std::cout << "#" << orderNum << " rejected: " << numOrdered << " kits to "
-                          << addr.number << " " << addr.street << ", "
-                          << addr.city << " " << addr.zip << " (" << totalOrdered << " already)" << std::endl;
-            }
+        // if analyze mode is on, log the result of each order processing
+        if (analyzeLog) {
+            analyzeLog->record(orderNum, order, accept, totalOrdered);
         }
         ++orderNum; // increment order number for tracking each order in sequence
     }
 }
+
+bool processOrder(Dictionary<StreetAddress, int>* dict, const COVIDTestOrder& order, int& totalOrdered) {
+    return processOrderWith(dict, order, totalOrdered);
+}
+
+bool processOrder(Dictionary<AddressKey, int>* dict, const COVIDTestOrder& order, int& totalOrdered) {
+    return processOrderWith(dict, order, totalOrdered);
+}
+
+void runSimulator(const std::vector<COVIDTestOrder>& orders, Dictionary<StreetAddress, int>* dict,
+                  DecisionLog* analyzeLog, LatencyHistogram* latencies, OrderClock* clock,
+                  int firstOrderNum) {
+    runSimulatorWith(orders, dict, analyzeLog, latencies, clock, firstOrderNum);
+}
+
+void runSimulator(const std::vector<COVIDTestOrder>& orders, Dictionary<AddressKey, int>* dict,
+                  DecisionLog* analyzeLog, LatencyHistogram* latencies, OrderClock* clock,
+                  int firstOrderNum) {
+    runSimulatorWith(orders, dict, analyzeLog, latencies, clock, firstOrderNum);
+}
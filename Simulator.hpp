@@ -3,5 +3,32 @@
 #include <vector>
 #include "COVIDTestOrder.hpp"
 #include "Dictionary.hpp"
+#include "AddressKey.hpp"
+#include "LatencyHistogram.hpp"
+#include "DecisionLog.hpp"
+#include "WindowedDictionary.hpp"
 
-void runSimulator(const std::vector<COVIDTestOrder>& orders, Dictionary<StreetAddress, int>* dict, bool analyze);
\ No newline at end of file
+// The most kits one household may be sent
+const int MAX_KITS_PER_ADDRESS = 4;
+
+// Applies the per-household cap to one order, updating `dict` if the order is accepted.
+// Returns whether it was accepted; `totalOrdered` is set to the household's new total if so,
+// or to what it already had if not. A dictionary too full for a new household is grown first.
+bool processOrder(Dictionary<StreetAddress, int>* dict, const COVIDTestOrder& order, int& totalOrdered);
+bool processOrder(Dictionary<AddressKey, int>* dict, const COVIDTestOrder& order, int& totalOrdered);
+
+// Runs every order through the per-household cap, using `dict` to remember how many kits
+// each address has been sent so far.
+// If `analyzeLog` is not null, every decision is recorded in it.
+// If `latencies` is not null, the time spent on each order (in nanoseconds) is recorded into it;
+// when it is null, no per-order timing is done at all.
+// If `clock` is not null, it is advanced to each order's number before the order is processed
+// (e.g. so a WindowedDictionary can expire old households as orders arrive).
+// Orders are numbered from `firstOrderNum`, e.g. to continue a run restarted from a snapshot.
+// The AddressKey version turns each order's address into an inline key first.
+void runSimulator(const std::vector<COVIDTestOrder>& orders, Dictionary<StreetAddress, int>* dict,
+                  DecisionLog* analyzeLog, LatencyHistogram* latencies = nullptr, OrderClock* clock = nullptr,
+                  int firstOrderNum = 1);
+void runSimulator(const std::vector<COVIDTestOrder>& orders, Dictionary<AddressKey, int>* dict,
+                  DecisionLog* analyzeLog, LatencyHistogram* latencies = nullptr, OrderClock* clock = nullptr,
+                  int firstOrderNum = 1);
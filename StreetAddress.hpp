@@ -15,4 +15,19 @@ struct StreetAddress {
                city == other.city &&
                zip == other.zip;
     }
+
+    // Orders addresses by zip, then city, then street, then number,
+    // so everything in one zip (or on one street) is contiguous in an ordered dictionary
+    bool operator<(const StreetAddress& other) const {
+        if (zip != other.zip) {
+            return zip < other.zip;
+        }
+        if (city != other.city) {
+            return city < other.city;
+        }
+        if (street != other.street) {
+            return street < other.street;
+        }
+        return number < other.number;
+    }
 };
\ No newline at end of file
@@ -1,7 +1,48 @@
 #include "Timer.hpp"
 #include <string>
+#include <thread>
 
-Timer::Timer() {
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#define TIMER_HAS_TSC 1
+#else
+#define TIMER_HAS_TSC 0
+#endif
+
+namespace {
+    long long steadyNanos() {
+        auto now = std::chrono::steady_clock::now().time_since_epoch();
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+    }
+
+    // How many nanoseconds one TSC tick lasts.
+    // Measured once against steady_clock the first time anybody asks for it.
+    double tscNanosPerTick() {
+#if TIMER_HAS_TSC
+        static const double nanosPerTick = [] {
+            long long ns0 = steadyNanos();
+            unsigned long long tsc0 = __rdtsc();
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            long long ns1 = steadyNanos();
+            unsigned long long tsc1 = __rdtsc();
+            return static_cast<double>(ns1 - ns0) / static_cast<double>(tsc1 - tsc0);
+        }();
+        return nanosPerTick;
+#else
+        return 1.0;
+#endif
+    }
+}
+
+Timer::Timer(Clock c) : clock(c), startTicks(0), endTicks(0), lapTicks(0), totalTicks(0) {
+    if (clock == Clock::TSC && !tscAvailable()) {
+        clock = Clock::STEADY;
+    }
+    if (clock == Clock::TSC) {
+        // calibrate now, rather than inside the first measurement
+        tscNanosPerTick();
+    }
     state = State::INVALID;
 }
 
@@ -9,12 +50,18 @@ void Timer::start() {
     // To try to make the timing as accurate as possible,
     // we'll make sure setting the start time is the very LAST thing
     // this function does
+    totalTicks = 0;
+    laps.clear();
+    resume();
+}
 
+void Timer::resume() {
     // Keep track of the fact that the timer is running,
     // so stop() and read() know whether to throw exceptions
     state = State::STARTED;
 
-    startTime = getCurrentTime();
+    startTicks = getCurrentTime();
+    lapTicks = startTicks;
 }
 
 void Timer::stop() {
@@ -37,19 +84,85 @@ void Timer::stop() {
         state = State::ENDED;
 
         // store the ending time we measured earlier.
-        endTime = temp;
+        endTicks = temp;
+        totalTicks += endTicks - startTicks;
     }
 }
 
+long long Timer::lap() {
+    auto temp = getCurrentTime();
+
+    if (state != State::STARTED) {
+        throw std::string("Timer::lap error: can't record a lap on a Timer that isn't running");
+    }
+    long long nanos = ticksToNanos(temp - lapTicks);
+    lapTicks = temp;
+    laps.push_back(nanos);
+    return nanos;
+}
+
 int Timer::read() const {
+    return static_cast<int>(readNanos() / 1000000);
+}
+
+double Timer::readMillis() const {
+    return readNanos() / 1e6;
+}
+
+long long Timer::readMicros() const {
+    return readNanos() / 1000;
+}
+
+long long Timer::readNanos() const {
     if (state != State::ENDED) {
         throw std::string("Timer::read error: can't read a Timer that has not been started and then stopped");
     } else {
-        auto measurement = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime);
-        return measurement.count();
+        return ticksToNanos(endTicks - startTicks);
     }
 }
 
-std::chrono::high_resolution_clock::time_point Timer::getCurrentTime() const {
-    return std::chrono::high_resolution_clock::now();
-}
\ No newline at end of file
+long long Timer::readTotalNanos() const {
+    if (state != State::ENDED) {
+        throw std::string("Timer::readTotalNanos error: can't read a Timer that has not been started and then stopped");
+    } else {
+        return ticksToNanos(totalTicks);
+    }
+}
+
+const std::vector<long long>& Timer::getLaps() const {
+    return laps;
+}
+
+bool Timer::tscAvailable() {
+#if TIMER_HAS_TSC
+    // only an invariant TSC (CPUID 0x80000007, EDX bit 8) ticks at a constant rate across
+    // frequency changes and sleep states; older CPUs' counters can't be turned into time
+    static const bool invariant = [] {
+        unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+        if (__get_cpuid_max(0x80000000, nullptr) < 0x80000007) {
+            return false;
+        }
+        __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+        return (edx & (1u << 8)) != 0;
+    }();
+    return invariant;
+#else
+    return false;
+#endif
+}
+
+long long Timer::getCurrentTime() const {
+#if TIMER_HAS_TSC
+    if (clock == Clock::TSC) {
+        return static_cast<long long>(__rdtsc());
+    }
+#endif
+    return steadyNanos();
+}
+
+long long Timer::ticksToNanos(long long ticks) const {
+    if (clock == Clock::TSC) {
+        return static_cast<long long>(ticks * tscNanosPerTick());
+    }
+    return ticks;
+}
@@ -1,20 +1,45 @@
 #pragma once
 
 #include <chrono>
+#include <vector>
 
 // A class that measures the real-world time (or something close enough to it)
 // that has passed between when its `start` and `stop` functions have been called.
-// It only stores a single, most-recent measurement.
+// Besides the most-recent measurement, it can also record laps and accumulate
+// the time from several start/stop pairs (see `resume` and `readTotalNanos`).
 class Timer {
+public:
+    // Which clock the Timer reads its ticks from
+    enum class Clock {
+        STEADY, // std::chrono::steady_clock, monotonic and always available
+        TSC,    // the CPU time-stamp counter: much cheaper to read, only on x86 CPUs
+                // with an invariant TSC (falls back to STEADY everywhere else)
+    };
+
 private:
-    // When the timer started
-    std::chrono::high_resolution_clock::time_point startTime;
+    // Which clock we read, fixed at construction
+    Clock clock;
+
+    // When the timer started, in clock ticks
+    long long startTicks;
+
+    // When the timer ended, in clock ticks
+    long long endTicks;
 
-    // When the timer ended
-    std::chrono::high_resolution_clock::time_point endTime;
+    // When the most recent lap ended (or the timer started), in clock ticks
+    long long lapTicks;
 
-    // A helper method that gets the current system time.
-    std::chrono::high_resolution_clock::time_point getCurrentTime() const;
+    // Sum of every start/stop (or resume/stop) pair since the last `start`, in clock ticks
+    long long totalTicks;
+
+    // Every lap recorded since the last `start`, in nanoseconds
+    std::vector<long long> laps;
+
+    // A helper method that gets the current time in ticks of our clock.
+    long long getCurrentTime() const;
+
+    // Converts a difference between two readings of our clock into nanoseconds
+    long long ticksToNanos(long long ticks) const;
 
     // An enum that will help us keep track of whether they're using the Timer correctly
     enum class State {
@@ -27,21 +52,50 @@ private:
              // because I think it's an easy detail to miss)
 
 public:
-    Timer();
+    Timer(Clock clock = Clock::STEADY);
 
     // Starts counting how much time is passing.
-    // This will clear any stored data from previous uses of the same Timer object,
+    // This will clear any stored data from previous uses of the same Timer object
+    // (including laps and the accumulated total),
     // or reset the start time if you've already started timing something.
     // You will not be able to `read()` the Timer until you run `stop()`.
     void start();
 
-    // Stops counting how much time is passing.
+    // Like `start`, but keeps the accumulated total and the laps,
+    // so the next `stop` adds to them instead of replacing them.
+    void resume();
+
+    // Stops counting how much time is passing, and adds the measurement to the total.
     // Invalidates any existing measurement and throws an exception
     // if you haven't called `start` before calling this method.
     void stop();
 
+    // Records a lap without stopping the timer: returns (and stores) the number of
+    // nanoseconds since the previous lap, or since `start` if this is the first one.
+    // Throws an exception if the timer is not running.
+    long long lap();
+
     // Returns the amount of time most recently measured by the timer, in milliseconds:
     // specifically, the amount of time between the most recent calls to `start` and then `stop`.
     // Throws an exception if you have not done so.
     int read() const;
-};
\ No newline at end of file
+
+    // Same as `read`, but with fractional milliseconds
+    double readMillis() const;
+
+    // Same as `read`, but in microseconds
+    long long readMicros() const;
+
+    // Same as `read`, but in nanoseconds
+    long long readNanos() const;
+
+    // Returns the sum of every measurement since the last `start`, in nanoseconds.
+    // Throws an exception if the timer is not currently stopped.
+    long long readTotalNanos() const;
+
+    // Returns every lap recorded since the last `start`, in nanoseconds
+    const std::vector<long long>& getLaps() const;
+
+    // Whether Clock::TSC really reads the time-stamp counter on this machine
+    static bool tscAvailable();
+};
@@ -2,8 +2,11 @@
 
 #include "Dictionary.hpp"
 #include <stdexcept>
+#include <memory>
+#include <utility>
 
-template<typename Key, typename Val>
+// `Allocator` supplies the record array (rebound to the record type); see HugePageAllocator
+template<typename Key, typename Val, typename Allocator = std::allocator<std::pair<const Key, Val>>>
 class UnsortedArrayDictionary : public Dictionary<Key, Val> {
 private:
     // An element in the dictionary, contains a key and a value
@@ -15,16 +18,23 @@ private:
         Record(Key x, Val y) : k(x), v(y) {}
     };
 
+    typedef typename std::allocator_traits<Allocator>::template rebind_alloc<Record> RecordAllocator;
+
+    RecordAllocator recordAllocator;
     Record* buffer;
     int maxSize;
     int length;
 
-    void copy(const UnsortedArrayDictionary<Key, Val>&);
+    void copy(const UnsortedArrayDictionary<Key, Val, Allocator>&);
+
+    // allocates and default-constructs `maxSize` records, and destroys and frees them
+    void allocateBuffer();
+    void freeBuffer();
 
 public:
-    UnsortedArrayDictionary(int maxSize = 100);
-    UnsortedArrayDictionary(const UnsortedArrayDictionary<Key, Val>&);
-    UnsortedArrayDictionary<Key, Val>& operator=(const UnsortedArrayDictionary<Key, Val>&);
+    UnsortedArrayDictionary(int maxSize = 100, const Allocator& allocator = Allocator());
+    UnsortedArrayDictionary(const UnsortedArrayDictionary<Key, Val, Allocator>&);
+    UnsortedArrayDictionary<Key, Val, Allocator>& operator=(const UnsortedArrayDictionary<Key, Val, Allocator>&);
     virtual ~UnsortedArrayDictionary();
 
     virtual void clear() override;
@@ -32,55 +42,76 @@ public:
     virtual void insert(const Key&, const Val&) override;
     virtual void remove(const Key&) override;
     virtual int size() const override;
+    virtual int slotCount() const override; // the records are packed, so only the first size() slots
+    virtual void reserve(int capacity) override; // moves the records to a buffer of `capacity`
+    virtual void forEachInRange(int begin, int end,
+                                const std::function<void(const Key&, const Val&)>& visit) const override;
 };
 
 // Implementation
 
-template<typename Key, typename Val>
-UnsortedArrayDictionary<Key, Val>::UnsortedArrayDictionary(int i)
-    : maxSize(i), length(0) {
-    buffer = new Record[maxSize];
+template<typename Key, typename Val, typename Allocator>
+UnsortedArrayDictionary<Key, Val, Allocator>::UnsortedArrayDictionary(int i, const Allocator& allocator)
+    : recordAllocator(allocator), maxSize(i), length(0) {
+    allocateBuffer();
 }
 
-template<typename Key, typename Val>
-UnsortedArrayDictionary<Key, Val>::UnsortedArrayDictionary(
-    const UnsortedArrayDictionary<Key, Val>& copyObj) {
+template<typename Key, typename Val, typename Allocator>
+UnsortedArrayDictionary<Key, Val, Allocator>::UnsortedArrayDictionary(
+    const UnsortedArrayDictionary<Key, Val, Allocator>& copyObj)
+    : recordAllocator(copyObj.recordAllocator) {
     copy(copyObj);
 }
 
-template<typename Key, typename Val>
-UnsortedArrayDictionary<Key, Val>& UnsortedArrayDictionary<Key, Val>::operator=(
-    const UnsortedArrayDictionary<Key, Val>& rightObj) {
+template<typename Key, typename Val, typename Allocator>
+UnsortedArrayDictionary<Key, Val, Allocator>& UnsortedArrayDictionary<Key, Val, Allocator>::operator=(
+    const UnsortedArrayDictionary<Key, Val, Allocator>& rightObj) {
     if (this != &rightObj) {
-        delete[] buffer;
+        freeBuffer();
         copy(rightObj);
     }
     return *this;
 }
 
-template<typename Key, typename Val>
-UnsortedArrayDictionary<Key, Val>::~UnsortedArrayDictionary() {
-    delete[] buffer;
+template<typename Key, typename Val, typename Allocator>
+UnsortedArrayDictionary<Key, Val, Allocator>::~UnsortedArrayDictionary() {
+    freeBuffer();
+}
+
+template<typename Key, typename Val, typename Allocator>
+void UnsortedArrayDictionary<Key, Val, Allocator>::allocateBuffer() {
+    buffer = std::allocator_traits<RecordAllocator>::allocate(recordAllocator, maxSize);
+    for (int i = 0; i < maxSize; i++) {
+        std::allocator_traits<RecordAllocator>::construct(recordAllocator, buffer + i);
+    }
+}
+
+template<typename Key, typename Val, typename Allocator>
+void UnsortedArrayDictionary<Key, Val, Allocator>::freeBuffer() {
+    for (int i = 0; i < maxSize; i++) {
+        std::allocator_traits<RecordAllocator>::destroy(recordAllocator, buffer + i);
+    }
+    std::allocator_traits<RecordAllocator>::deallocate(recordAllocator, buffer, maxSize);
 }
 
-template<typename Key, typename Val>
-void UnsortedArrayDictionary<Key, Val>::clear() {
+template<typename Key, typename Val, typename Allocator>
+void UnsortedArrayDictionary<Key, Val, Allocator>::clear() {
     length = 0;
 }
 
-template<typename Key, typename Val>
-void UnsortedArrayDictionary<Key, Val>::copy(
-    const UnsortedArrayDictionary<Key, Val>& copyObj) {
+template<typename Key, typename Val, typename Allocator>
+void UnsortedArrayDictionary<Key, Val, Allocator>::copy(
+    const UnsortedArrayDictionary<Key, Val, Allocator>& copyObj) {
     maxSize = copyObj.maxSize;
     length = copyObj.length;
-    buffer = new Record[maxSize];
+    allocateBuffer();
     for (int i = 0; i < length; i++) {
         buffer[i] = copyObj.buffer[i];
     }
 }
 
-template<typename Key, typename Val>
-Val UnsortedArrayDictionary<Key, Val>::find(const Key& k) const {
+template<typename Key, typename Val, typename Allocator>
+Val UnsortedArrayDictionary<Key, Val, Allocator>::find(const Key& k) const {
     for (int i = 0; i < length; i++) {
         if (buffer[i].k == k) {
             return buffer[i].v;
@@ -89,8 +120,8 @@ Val UnsortedArrayDictionary<Key, Val>::find(const Key& k) const {
     throw std::runtime_error("find: error, key not found");
 }
 
-template<typename Key, typename Val>
-void UnsortedArrayDictionary<Key, Val>::insert(const Key& k, const Val& v) {
+template<typename Key, typename Val, typename Allocator>
+void UnsortedArrayDictionary<Key, Val, Allocator>::insert(const Key& k, const Val& v) {
     for (int i = 0; i < length; i++) {
         if (buffer[i].k == k) {
             // Key exists - update value
@@ -105,8 +136,8 @@ void UnsortedArrayDictionary<Key, Val>::insert(const Key& k, const Val& v) {
     length++;
 }
 
-template<typename Key, typename Val>
-void UnsortedArrayDictionary<Key, Val>::remove(const Key& k) {
+template<typename Key, typename Val, typename Allocator>
+void UnsortedArrayDictionary<Key, Val, Allocator>::remove(const Key& k) {
     for (int i = 0; i < length; i++) {
         if (buffer[i].k == k) {
             buffer[i] = buffer[length - 1];
@@ -117,7 +148,39 @@ void UnsortedArrayDictionary<Key, Val>::remove(const Key& k) {
     throw std::runtime_error("remove: error, key not found");
 }
 
-template<typename Key, typename Val>
-int UnsortedArrayDictionary<Key, Val>::size() const {
+template<typename Key, typename Val, typename Allocator>
+int UnsortedArrayDictionary<Key, Val, Allocator>::size() const {
+    return length;
+}
+
+template<typename Key, typename Val, typename Allocator>
+int UnsortedArrayDictionary<Key, Val, Allocator>::slotCount() const {
     return length;
+}
+
+template<typename Key, typename Val, typename Allocator>
+void UnsortedArrayDictionary<Key, Val, Allocator>::reserve(int capacity) {
+    if (capacity <= maxSize) {
+        return;
+    }
+    Record* oldBuffer = buffer;
+    int oldSize = maxSize;
+    maxSize = capacity;
+    allocateBuffer();
+    for (int i = 0; i < length; i++) {
+        buffer[i] = oldBuffer[i];
+    }
+    for (int i = 0; i < oldSize; i++) {
+        std::allocator_traits<RecordAllocator>::destroy(recordAllocator, oldBuffer + i);
+    }
+    std::allocator_traits<RecordAllocator>::deallocate(recordAllocator, oldBuffer, oldSize);
+}
+
+template<typename Key, typename Val, typename Allocator>
+void UnsortedArrayDictionary<Key, Val, Allocator>::forEachInRange(
+    int begin, int end, const std::function<void(const Key&, const Val&)>& visit) const {
+    // records are packed at the front of the buffer
+    for (int i = begin; i < end && i < length; i++) {
+        visit(buffer[i].k, buffer[i].v);
+    }
 }
\ No newline at end of file
@@ -0,0 +1,251 @@
+#pragma once
+
+#include "Dictionary.hpp"
+#include <deque>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <vector>
+
+// A value stamped with the epoch its key was inserted in (see WindowedDictionary)
+template<typename Val>
+struct WindowedEntry {
+    Val value;
+    long long epoch;
+
+    WindowedEntry(const Val& v = Val(), long long e = 0) : value(v), epoch(e) {}
+};
+
+// Something whose records age as orders arrive; the simulator tells it the time before each order
+class OrderClock {
+public:
+    virtual ~OrderClock() {}
+
+    // Moves the clock forward to `now`, which never decreases
+    virtual void advance(long long now) = 0;
+};
+
+// A dictionary whose records expire `window` time units after their key was first inserted,
+// so per-household quotas reset on a rolling window without ever wiping the whole table.
+// Time is split into epochs of about window / EPOCHS_PER_WINDOW units, and each key is also listed
+// in the bucket of the epoch it was inserted in. When an epoch leaves the window its bucket is queued,
+// and every advance() removes at most `batchSize` queued keys from the underlying table; until then,
+// expired records are simply treated as missing. Records can outlive the window by up to about one epoch.
+template<typename Key, typename Val>
+class WindowedDictionary : public Dictionary<Key, Val>, public OrderClock {
+private:
+    static const int EPOCHS_PER_WINDOW = 8;
+    static const int BUCKETS = EPOCHS_PER_WINDOW + 1; // the live epochs plus the current one
+
+    std::unique_ptr<Dictionary<Key, WindowedEntry<Val>>> table;
+    long long window;
+    long long epochLength;
+    long long epoch;            // the current epoch
+    int batchSize;
+
+    std::vector<std::vector<Key>> buckets;  // buckets[e % BUCKETS]: keys inserted in epoch e
+    std::vector<int> liveInBucket;          // how many of those keys are still live records
+    std::deque<std::vector<Key>> expired;   // buckets that left the window, waiting to be reclaimed
+    std::size_t reclaimPosition;            // how far into expired.front() reclaiming has got
+    long long waiting;                      // keys left in `expired`
+
+    int live;                   // records inside the window
+    long long expiredRecords;   // records that have left the window
+    long long reclaimedRecords; // expired records removed from the table
+
+    // The last key find() didn't find: callers usually insert it next, and this saves
+    // insert() a second failed lookup (and its exception). Only a miss copies the key.
+    mutable Key lastMissing;
+    mutable bool haveLastMissing;
+
+    void noteMissing(const Key& k) const {
+        lastMissing = k;
+        haveLastMissing = true;
+    }
+
+    bool isLive(const WindowedEntry<Val>& entry) const {
+        return entry.epoch > epoch - BUCKETS;
+    }
+
+    // Removes up to `count` expired records from the table
+    void reclaim(int count);
+
+public:
+    // `table` holds the stamped records (and is owned from now on); `window` is in the same
+    // units as the times passed to advance()
+    WindowedDictionary(std::unique_ptr<Dictionary<Key, WindowedEntry<Val>>> table, long long window,
+                       int batchSize = 4);
+
+    // dictionary interface methods
+    virtual void clear() override;
+    virtual Val find(const Key&) const override;
+    virtual void insert(const Key&, const Val&) override;
+    virtual void remove(const Key&) override;
+    virtual int size() const override;
+    virtual int slotCount() const override;
+    virtual void reserve(int capacity) override;
+    virtual void forEachInRange(int begin, int end,
+                                const std::function<void(const Key&, const Val&)>& visit) const override;
+
+    // expires every epoch that has left the window by `now`, then reclaims one batch
+    virtual void advance(long long now) override;
+
+    // Prints the window settings and how many records have expired and been reclaimed
+    void printWindow(std::ostream& out) const;
+};
+
+// implementation
+
+template<typename Key, typename Val>
+WindowedDictionary<Key, Val>::WindowedDictionary(std::unique_ptr<Dictionary<Key, WindowedEntry<Val>>> t,
+                                                 long long w, int batch)
+    : table(std::move(t)), window(w), epoch(0), batchSize(batch), buckets(BUCKETS), liveInBucket(BUCKETS, 0),
+      reclaimPosition(0), waiting(0), live(0), expiredRecords(0), reclaimedRecords(0), haveLastMissing(false) {
+    if (window <= 0 || batchSize <= 0) {
+        throw std::runtime_error("WindowedDictionary: window and batch size must be positive");
+    }
+    epochLength = (window + EPOCHS_PER_WINDOW - 1) / EPOCHS_PER_WINDOW;
+}
+
+template<typename Key, typename Val>
+void WindowedDictionary<Key, Val>::clear() {
+    table->clear();
+    for (int i = 0; i < BUCKETS; i++) {
+        buckets[i].clear();
+        liveInBucket[i] = 0;
+    }
+    expired.clear();
+    reclaimPosition = 0;
+    waiting = 0;
+    live = 0;
+    haveLastMissing = false;
+}
+
+template<typename Key, typename Val>
+Val WindowedDictionary<Key, Val>::find(const Key& k) const {
+    WindowedEntry<Val> entry;
+    try {
+        entry = table->find(k);
+    } catch (const std::exception&) {
+        noteMissing(k);
+        throw;
+    }
+    if (!isLive(entry)) {
+        noteMissing(k);
+        throw std::runtime_error("find: error, key not found");
+    }
+    haveLastMissing = false;
+    return entry.value;
+}
+
+template<typename Key, typename Val>
+void WindowedDictionary<Key, Val>::insert(const Key& k, const Val& v) {
+    long long stamp = epoch;
+    bool added = true;
+    if (haveLastMissing && lastMissing == k) {
+        // find() has just been told this key isn't live
+        haveLastMissing = false;
+    } else {
+        try {
+            WindowedEntry<Val> entry = table->find(k);
+            if (isLive(entry)) {
+                // an update keeps the epoch the household's window started in
+                stamp = entry.epoch;
+                added = false;
+            }
+        } catch (const std::exception&) {
+            // not in the table yet
+        }
+    }
+    table->insert(k, WindowedEntry<Val>(v, stamp));
+    if (added) {
+        buckets[epoch % BUCKETS].push_back(k);
+        liveInBucket[epoch % BUCKETS]++;
+        live++;
+    }
+}
+
+template<typename Key, typename Val>
+void WindowedDictionary<Key, Val>::remove(const Key& k) {
+    WindowedEntry<Val> entry = table->find(k);
+    if (!isLive(entry)) {
+        throw std::runtime_error("remove: error, key not found");
+    }
+    table->remove(k);
+    // the key stays in its bucket; reclaiming skips keys that are already gone
+    liveInBucket[entry.epoch % BUCKETS]--;
+    live--;
+}
+
+template<typename Key, typename Val>
+int WindowedDictionary<Key, Val>::size() const {
+    return live;
+}
+
+template<typename Key, typename Val>
+int WindowedDictionary<Key, Val>::slotCount() const {
+    return table->slotCount();
+}
+
+template<typename Key, typename Val>
+void WindowedDictionary<Key, Val>::reserve(int capacity) {
+    table->reserve(capacity);
+}
+
+template<typename Key, typename Val>
+void WindowedDictionary<Key, Val>::forEachInRange(
+    int begin, int end, const std::function<void(const Key&, const Val&)>& visit) const {
+    table->forEachInRange(begin, end, [this, &visit](const Key& k, const WindowedEntry<Val>& entry) {
+        if (isLive(entry)) {
+            visit(k, entry.value);
+        }
+    });
+}
+
+template<typename Key, typename Val>
+void WindowedDictionary<Key, Val>::advance(long long now) {
+    long long target = now / epochLength;
+    while (epoch < target) {
+        epoch++;
+        // this bucket held the epoch that just left the window; hand it over without touching its keys
+        int slot = static_cast<int>(epoch % BUCKETS);
+        expiredRecords += liveInBucket[slot];
+        live -= liveInBucket[slot];
+        liveInBucket[slot] = 0;
+        if (!buckets[slot].empty()) {
+            waiting += buckets[slot].size();
+            expired.push_back(std::move(buckets[slot]));
+            buckets[slot] = std::vector<Key>();
+        }
+    }
+    reclaim(batchSize);
+}
+
+template<typename Key, typename Val>
+void WindowedDictionary<Key, Val>::reclaim(int count) {
+    while (count > 0 && !expired.empty()) {
+        const Key& k = expired.front()[reclaimPosition];
+        try {
+            // the key may have been removed, or inserted again since it expired
+            if (!isLive(table->find(k))) {
+                table->remove(k);
+                reclaimedRecords++;
+            }
+        } catch (const std::exception&) {
+            // already gone
+        }
+        count--;
+        waiting--;
+        if (++reclaimPosition == expired.front().size()) {
+            expired.pop_front();
+            reclaimPosition = 0;
+        }
+    }
+}
+
+template<typename Key, typename Val>
+void WindowedDictionary<Key, Val>::printWindow(std::ostream& out) const {
+    out << "quota window: " << window << " in " << EPOCHS_PER_WINDOW << " epochs of " << epochLength
+        << ", " << live << " live, " << expiredRecords << " expired, " << reclaimedRecords << " reclaimed, "
+        << waiting << " keys waiting, " << table->size() << " records in the table" << std::endl;
+}
@@ -1,4 +1,6 @@
 #include "hashing.hpp"
+#include <cstdint>
+#include <cstring>
 
 int cs20::hash(const int& key) {
     int hashValue = key % 2147483647; // Use a large prime number to avoid overflow
@@ -31,3 +33,41 @@ int cs20::hash(const StreetAddress& key) {
     }
     return hashVal;
 }
+
+int cs20::hash(const AddressKey& key) {
+    // the key is a padding-free block of bytes, so mix it in 64-bit words
+    const int WORDS = sizeof(AddressKey) / sizeof(std::uint64_t);
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&key);
+    std::uint64_t h = 0x9E3779B97F4A7C15ULL;
+    for (int i = 0; i < WORDS; i++) {
+        std::uint64_t word;
+        std::memcpy(&word, bytes + i * sizeof(word), sizeof(word));
+        h = (h ^ word) * 0xBF58476D1CE4E5B9ULL;
+        h ^= h >> 31;
+    }
+    h ^= h >> 33;
+    h *= 0x94D049BB133111EBULL;
+    h ^= h >> 29;
+    return static_cast<int>(h % 2147483647);
+}
+
+std::uint64_t cs20::hash64(const StreetAddress& key) {
+    // FNV-1a over the fields, then a finalizer so every bit depends on every byte
+    std::uint64_t h = 0xCBF29CE484222325ULL;
+    auto mix = [&h](const void* data, std::size_t bytes) {
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        for (std::size_t i = 0; i < bytes; i++) {
+            h = (h ^ p[i]) * 0x100000001B3ULL;
+        }
+    };
+    mix(&key.number, sizeof(key.number));
+    mix(&key.zip, sizeof(key.zip));
+    mix(key.street.data(), key.street.size() + 1); // the terminator keeps "ab"+"c" apart from "a"+"bc"
+    mix(key.city.data(), key.city.size());
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return h;
+}
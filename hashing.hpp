@@ -1,10 +1,17 @@
 #pragma once
 
 #include "StreetAddress.hpp"
+#include "AddressKey.hpp"
+#include <cstdint>
 #include <string>
 
 namespace cs20 {
     int hash(const int& key);
     int hash(const std::string& key);
     int hash(const StreetAddress& key);
+    int hash(const AddressKey& key);
+
+    // a well-mixed 64-bit hash, independent of hash() (so addresses built to collide under
+    // hash() still spread out); for sketches such as HyperLogLog
+    std::uint64_t hash64(const StreetAddress& key);
 }
@@ -3,25 +3,81 @@
 #include <vector>
 #include <string>
 #include <chrono>
+#include <iomanip>
+#include <sstream>
+#include <memory>
+#include <csignal>
+#include <limits>
+#include <type_traits>
+#include <cmath>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <thread>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <unistd.h>
 
 #include "COVIDTestOrder.hpp"
 #include "UnsortedArrayDictionary.hpp"
 #include "HashTableClosed.hpp"
 #include "HashTableOpened.hpp"
+#include "MappedHashTable.hpp"
+#include "BPlusTree.hpp"
+#include "WindowedDictionary.hpp"
+#include "HugePageAllocator.hpp"
+#include "HyperLogLog.hpp"
 #include "Simulator.hpp"
 #include "Timer.hpp"
+#include "LatencyHistogram.hpp"
+#include "PerfCounters.hpp"
+#include "OrderGenerator.hpp"
+#include "AsyncLogSink.hpp"
+#include "DecisionLog.hpp"
+#include "OrderServer.hpp"
+#include "LoadGenerator.hpp"
+#include "OrderProtocol.hpp"
+#include "HouseholdReport.hpp"
 #include "hashing.hpp"
 
+// what to measure and print during each simulation, chosen once by the user
+struct SimulationOptions {
+    std::unique_ptr<AsyncLogSink> analyzeLog; // where every decision is written, or null
+    bool binaryAnalyze;   // write decisions as a binary log instead of text
+    bool recordLatencies; // per-order latency histogram
+    bool perfCounters;    // cycles, instructions, misses and page faults around each run
+    bool tableStats;      // hash table health statistics and probe counts
+    std::string snapshotPath; // where to save the household totals after each run, or empty
+    bool report;          // per-zip and per-city kit totals after each run
+    bool inlineKeys;      // key dictionaries by the fixed-size AddressKey instead of StreetAddress
+    long long quotaWindow; // orders after which a household's quota resets, or 0 for never
+    bool hugePages;       // allocate hash tables and arrays from a HugePageArena
+    double loadFactor;    // size new tables for estimated households at this load (below 1), or 0 for 4 * M slots
+};
+
 // function prototypes for running tests and the simulator loop
 void runTests();
-void runSimulatorLoop(const std::vector<COVIDTestOrder>& orders, bool analyze);
+void runSimulatorLoop(const std::vector<COVIDTestOrder>& orders, const SimulationOptions& options);
+void runGenerator();
+void runExpand();
+void runServer();
+void runLoadGenerator();
+bool loadOrders(const std::string& path, std::vector<COVIDTestOrder>& orders);
+SimulationOptions askSimulationOptions();
+bool askYesNo(const std::string& prompt);
+std::string fixed3(double value);
 
 using std::cout;
 using std::endl;
 
 int main() {
-    // prompt the user to choose to run either unit tests or the main simulator
-    cout << "Enter 'test' to run unit tests or 'run' to execute the simulator: ";
+    // prompt the user to choose to run either unit tests, the main simulator, the order generator,
+    // the binary decision log expander, the order server or its load generator
+    cout << "Enter 'test' to run unit tests, 'run' to execute the simulator, 'gen' to generate orders,"
+         << " 'expand' to turn a binary decision log into text, 'serve' to run the order server"
+         << " or 'load' to send orders to a running server: ";
     std::string choice;
     std::cin >> choice;
 
@@ -30,39 +86,25 @@ int main() {
         runTests();
     } else if (choice == "run") {
         // load orders from the csv file for the simulator
-        cout << "Loading orders from data/orders100k.csv..." << endl;
-        auto startTime = std::chrono::high_resolution_clock::now();
-
         std::vector<COVIDTestOrder> orders;
-        std::ifstream infile("data/orders100k.csv");
-        if (!infile) {
-            std::cerr << "Failed to open data/orders100k.csv" << endl;
+        if (!loadOrders("data/orders100k.csv", orders)) {
             return 1;
         }
 
-        std::string line;
-        // read each line from the csv file and parse it into COVIDTestOrder objects
-        while (std::getline(infile, line)) {
-            if (!line.empty()) {
-                orders.emplace_back(line);
-            }
-        }
-        infile.close();
-
-        // display the time taken to load the orders and the total number loaded
-        auto endTime = std::chrono::high_resolution_clock::now();
-        auto loadingDuration = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count();
-        cout << "Finished loading orders. Total orders read: " << orders.size()
-             << " in " << loadingDuration << " ms." << endl << endl;
-
-        // ask if the user wants analyze output (note: analyze mode affects timing)
-        cout << "Enable analyze output? (This will result in inaccurate time complexity, purely for debugging purposes) (yes/no): ";
-        std::string analyzeInput;
-        std::cin >> analyzeInput;
-        bool analyze = (analyzeInput == "yes" || analyzeInput == "Yes" || analyzeInput == "y" || analyzeInput == "Y");
-
         // run the main simulator loop
-        runSimulatorLoop(orders, analyze);
+        runSimulatorLoop(orders, askSimulationOptions());
+    } else if (choice == "gen") {
+        // generate synthetic orders, either into a csv file or straight into the simulator
+        runGenerator();
+    } else if (choice == "expand") {
+        // expand a binary decision log back into the analyze text format
+        runExpand();
+    } else if (choice == "serve") {
+        // keep the household totals in memory and answer orders over a unix socket
+        runServer();
+    } else if (choice == "load") {
+        // measure a running server's latency and throughput
+        runLoadGenerator();
     } else {
         std::cerr << "Invalid choice." << endl;
     }
@@ -71,8 +113,563 @@ int main() {
     return 0;
 }
 
+// function to load every order in a csv file, printing how long it took;
+// returns false if the file can't be opened
+bool loadOrders(const std::string& path, std::vector<COVIDTestOrder>& orders) {
+    cout << "Loading orders from " << path << "..." << endl;
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    std::ifstream infile(path);
+    if (!infile) {
+        std::cerr << "Failed to open " << path << endl;
+        return false;
+    }
+
+    std::string line;
+    // read each line from the csv file and parse it into COVIDTestOrder objects
+    while (std::getline(infile, line)) {
+        if (!line.empty()) {
+            orders.emplace_back(line);
+        }
+    }
+    infile.close();
+
+    // display the time taken to load the orders and the total number loaded
+    auto endTime = std::chrono::high_resolution_clock::now();
+    auto loadingDuration = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count();
+    cout << "Finished loading orders. Total orders read: " << orders.size()
+         << " in " << loadingDuration << " ms." << endl << endl;
+    return true;
+}
+
+// function to ask the user what to measure and print during each simulation
+SimulationOptions askSimulationOptions() {
+    SimulationOptions options;
+    options.binaryAnalyze = false;
+
+    // ask if the user wants analyze output (note: analyze mode adds some formatting time to each order;
+    // the writing itself happens on a background thread)
+    if (askYesNo("Enable analyze output? (yes/no): ")) {
+        options.binaryAnalyze = askYesNo("Write a compact binary decision log instead of text? (yes/no): ");
+        cout << "Enter analyze output file (or '-' for the console): ";
+        std::string path;
+        std::cin >> path;
+        try {
+            options.analyzeLog.reset(new AsyncLogSink(AsyncLogSink::openFile(path), path != "-"));
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << ", analyze output disabled." << endl;
+        }
+    }
+
+    // ask if the user wants the per-order latency distribution (adds a little timing overhead per order)
+    options.recordLatencies = askYesNo("Record per-order latency histogram? (yes/no): ");
+    if (options.recordLatencies) {
+        Timer calibrate(Timer::Clock::TSC); // calibrates the TSC now rather than during the first run
+    }
+
+    // ask if the user wants CPU and kernel counters around each run (opens perf events per run)
+    options.perfCounters = askYesNo("Count cycles, instructions and misses during each run? (yes/no): ");
+
+    // ask if the user wants hash table health statistics and probe counts after each run
+    options.tableStats = askYesNo("Print hash table statistics after each run? (yes/no): ");
+
+    // ask if the user wants the per-zip and per-city aggregates after each run
+    options.report = askYesNo("Print per-zip and per-city report after each run? (yes/no): ");
+
+    // ask if the user wants dictionaries keyed by inline fixed-size copies of the addresses
+    options.inlineKeys = askYesNo("Use inline fixed-size address keys (AddressKey)? (yes/no): ");
+
+    // ask if the user wants dictionary memory mapped with huge pages on the local NUMA node
+    options.hugePages = askYesNo("Allocate dictionaries from huge pages? (yes/no): ");
+
+    // ask if tables should be sized from an estimate of the distinct households instead of 4 * M
+    cout << "Enter a target load factor below 1 to size tables by estimated households (0 for 4 * M slots): ";
+    std::string load;
+    std::cin >> load;
+    try {
+        options.loadFactor = std::stod(load);
+        // a closed table only grows once every slot is taken, so a full load would leave no slack
+        // for an estimate that comes in low
+        if (options.loadFactor < 0 || options.loadFactor >= 1) {
+            std::cerr << "The load factor must be at least 0 and below 1, tables will have 4 * M slots." << endl;
+            options.loadFactor = 0;
+        }
+    } catch (const std::exception&) {
+        std::cerr << "Invalid load factor, tables will have 4 * M slots." << endl;
+        options.loadFactor = 0;
+    }
+
+    // ask if household quotas should reset on a rolling window of orders
+    cout << "Enter a rolling quota window in orders (0 for no window): ";
+    std::string window;
+    std::cin >> window;
+    try {
+        options.quotaWindow = std::max(0LL, std::stoll(window));
+    } catch (const std::exception&) {
+        std::cerr << "Invalid window, quotas will not reset." << endl;
+        options.quotaWindow = 0;
+    }
+
+    // ask if the user wants the household totals saved, so a later run can restart from them
+    cout << "Enter a snapshot file to save HashTableClosed/MappedHashTable totals to after each run (or '-' to skip): ";
+    std::cin >> options.snapshotPath;
+    if (options.snapshotPath == "-") {
+        options.snapshotPath.clear();
+    }
+
+    return options;
+}
+
+// function to ask for the generator settings, then either write the orders to a csv file
+// or run them through the simulator loop
+void runGenerator() {
+    OrderGeneratorConfig config;
+    long long count;
+    std::string input;
+    try {
+        cout << "Enter number of orders to generate: ";
+        std::cin >> input;
+        count = std::stoll(input);
+        cout << "Enter number of distinct addresses: ";
+        std::cin >> input;
+        config.distinctAddresses = std::stoll(input);
+        cout << "Enter Zipf exponent for repeat orders (0 for uniform, 1 for heavily skewed): ";
+        std::cin >> input;
+        config.zipfExponent = std::stod(input);
+        cout << "Enter random seed: ";
+        std::cin >> input;
+        config.seed = std::stoull(input);
+    } catch (const std::exception&) {
+        std::cerr << "Invalid input. Please enter a number." << endl;
+        return;
+    }
+    if (count <= 0 || config.distinctAddresses <= 0 || config.zipfExponent < 0) {
+        std::cerr << "Please enter positive counts and a non-negative exponent." << endl;
+        return;
+    }
+    config.colliding = askYesNo("Make every address collide under cs20::hash? (yes/no): ");
+
+    cout << "Enter output csv file (or '-' to simulate the orders directly): ";
+    std::string path;
+    std::cin >> path;
+
+    std::unique_ptr<OrderGenerator> generator;
+    try {
+        generator.reset(new OrderGenerator(config));
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << endl;
+        return;
+    }
+    Timer timer;
+    if (path != "-") {
+        // stream straight to the file, so the order count isn't limited by memory
+        std::ofstream outfile(path);
+        if (!outfile) {
+            std::cerr << "Failed to open " << path << endl;
+            return;
+        }
+        timer.start();
+        generator->writeCsv(outfile, count);
+        outfile.close();
+        timer.stop();
+        cout << "Wrote " << count << " orders to " << path << " in " << timer.read() << " ms." << endl << endl;
+        return;
+    }
+
+    timer.start();
+    std::vector<COVIDTestOrder> orders = generator->generate(count);
+    timer.stop();
+    cout << "Finished generating orders. Total orders generated: " << orders.size()
+         << " in " << timer.read() << " ms." << endl << endl;
+    runSimulatorLoop(orders, askSimulationOptions());
+}
+
+// function to expand a binary decision log into the analyze text format,
+// using the orders file the log was recorded from
+void runExpand() {
+    std::string logPath, ordersPath, outPath;
+    cout << "Enter binary decision log file: ";
+    std::cin >> logPath;
+    cout << "Enter the orders csv file it was recorded from (e.g. data/orders100k.csv): ";
+    std::cin >> ordersPath;
+    cout << "Enter output file (or '-' for the console): ";
+    std::cin >> outPath;
+
+    std::ifstream logFile(logPath, std::ios::binary);
+    if (!logFile) {
+        std::cerr << "Failed to open " << logPath << endl;
+        return;
+    }
+    std::vector<COVIDTestOrder> orders;
+    if (!loadOrders(ordersPath, orders)) {
+        return;
+    }
+    try {
+        AsyncLogSink out(AsyncLogSink::openFile(outPath), outPath != "-");
+        long long expanded = expandDecisionLog(logFile, orders, out);
+        out.flush();
+        cout << "Expanded " << expanded << " decisions." << endl;
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << endl;
+    }
+}
+
+// set by SIGINT/SIGTERM to stop the order server
+volatile std::sig_atomic_t stopServer = 0;
+
+void requestServerStop(int) {
+    stopServer = 1;
+}
+
+// function to run the order server until it is interrupted
+void runServer() {
+    std::string path, sizeInput;
+    cout << "Enter socket path: ";
+    std::cin >> path;
+    cout << "Enter hash table size (the most households the server can hold): ";
+    std::cin >> sizeInput;
+    int tableSize;
+    try {
+        tableSize = std::stoi(sizeInput);
+        if (tableSize <= 0) {
+            std::cerr << "Please enter a positive integer for the table size." << endl;
+            return;
+        }
+    } catch (const std::exception&) {
+        std::cerr << "Invalid input. Please enter a positive integer." << endl;
+        return;
+    }
+
+    HashTableClosed<StreetAddress, int> hashDict(tableSize);
+    try {
+        OrderServer server(path, &hashDict);
+        std::signal(SIGINT, requestServerStop);
+        std::signal(SIGTERM, requestServerStop);
+        std::signal(SIGPIPE, SIG_IGN); // a client disconnecting mid-write is just a failed write
+        cout << "Serving orders on " << path << " (Ctrl-C to stop)..." << endl;
+        server.run(stopServer);
+        cout << endl << "Served " << server.requestsServed() << " orders in " << server.batchesServed()
+             << " batches; " << hashDict.size() << " households on record." << endl;
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << endl;
+    }
+}
+
+// function to send orders to a running server and report latency and throughput
+void runLoadGenerator() {
+    std::string path, ordersPath, countInput, depthInput;
+    cout << "Enter socket path: ";
+    std::cin >> path;
+    cout << "Enter orders csv file (e.g. data/orders100k.csv): ";
+    std::cin >> ordersPath;
+    cout << "Enter number of orders to send: ";
+    std::cin >> countInput;
+    cout << "Enter pipeline depth (requests in flight): ";
+    std::cin >> depthInput;
+    long long count;
+    int depth;
+    try {
+        count = std::stoll(countInput);
+        depth = std::stoi(depthInput);
+        if (count <= 0 || depth <= 0) {
+            std::cerr << "Please enter positive integers." << endl;
+            return;
+        }
+    } catch (const std::exception&) {
+        std::cerr << "Invalid input. Please enter positive integers." << endl;
+        return;
+    }
+
+    std::vector<COVIDTestOrder> orders;
+    if (!loadOrders(ordersPath, orders)) {
+        return;
+    }
+    if (count < static_cast<long long>(orders.size())) {
+        orders.resize(count);
+    }
+    try {
+        LoadReport report = runLoad(path, orders, depth);
+        cout << "Sent " << report.requests << " orders (" << report.accepted << " accepted) in "
+             << fixed3(report.seconds) << " s: "
+             << static_cast<long long>(report.requests / report.seconds) << " orders/s" << endl;
+        cout << "latency: ";
+        report.latencies.print(cout);
+        cout << endl;
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << endl;
+    }
+}
+
+// function to ask the user a yes/no question, returning true for yes
+bool askYesNo(const std::string& prompt) {
+    cout << prompt;
+    std::string input;
+    std::cin >> input;
+    return input == "yes" || input == "Yes" || input == "y" || input == "Y";
+}
+
+// function to format a number with three decimals, leaving cout's own formatting alone
+std::string fixed3(double value) {
+    std::ostringstream text;
+    text << std::fixed << std::setprecision(3) << value;
+    return text.str();
+}
+
+// functions to switch on probe counting and to print a table's health afterwards;
+// dictionaries that aren't hash tables have nothing to report
+template<typename HashTable>
+void startTableStats(HashTable& table) {
+    table.resetProbeCounters();
+    table.countProbes(true);
+}
+
+template<typename HashTable>
+void printTableStats(const HashTable& table) {
+    table.stats().print(cout);
+    table.probeCounters().print(cout);
+}
+
+template<typename Key, typename Allocator>
+void startTableStats(UnsortedArrayDictionary<Key, int, Allocator>&) {}
+template<typename Key, typename Allocator>
+void printTableStats(const UnsortedArrayDictionary<Key, int, Allocator>&) {}
+void startTableStats(MappedHashTable&) {}
+void printTableStats(const MappedHashTable&) {}
+template<typename Key>
+void startTableStats(BPlusTree<Key, int>&) {}
+template<typename Key>
+void printTableStats(const BPlusTree<Key, int>&) {}
+template<typename Key>
+void startTableStats(WindowedDictionary<Key, int>&) {}
+template<typename Key>
+void printTableStats(const WindowedDictionary<Key, int>& dict) {
+    dict.printWindow(cout);
+}
+
+// function to find what the simulator should advance before each order, if anything
+template<typename DictType>
+OrderClock* clockFor(DictType&) {
+    return nullptr;
+}
+
+template<typename Key>
+OrderClock* clockFor(WindowedDictionary<Key, int>& dict) {
+    return &dict;
+}
+
+// function to show off an ordered range scan: every household in one zip code
+template<typename Key>
+void printZipScan(const BPlusTree<Key, int>& tree, int zip) {
+    Key low;
+    low.number = std::numeric_limits<int>::min();
+    low.zip = zip;
+    int households = 0;
+    int kits = 0;
+    Timer timer;
+    timer.start();
+    tree.scanFrom(low, [&](const Key& address, const int& total) {
+        if (address.zip != zip) {
+            return false;
+        }
+        households++;
+        kits += total;
+        return true;
+    });
+    timer.stop();
+    cout << "Zip " << zip << ": " << households << " households, " << kits << " kits (range scan took "
+         << timer.readMicros() << " us)" << endl << endl;
+}
+
+// function to save a snapshot of the household totals if the user asked for one,
+// recording that they cover the first `ordersProcessed` orders
+template<typename Table>
+void saveSnapshot(const Table& table, const SimulationOptions& options, long long ordersProcessed) {
+    if (options.snapshotPath.empty()) {
+        return;
+    }
+    Timer timer;
+    timer.start();
+    MappedHashTable::save(table, options.snapshotPath, ordersProcessed);
+    timer.stop();
+    cout << "Saved snapshot of " << table.size() << " households to " << options.snapshotPath
+         << " in " << fixed3(timer.readMillis()) << " ms" << endl << endl;
+}
+
+void saveSnapshot(const MappedHashTable& table, const SimulationOptions& options) {
+    if (options.snapshotPath.empty()) {
+        return;
+    }
+    Timer timer;
+    timer.start();
+    table.save(options.snapshotPath); // records table.ordersProcessed()
+    timer.stop();
+    cout << "Saved snapshot of " << table.size() << " households to " << options.snapshotPath
+         << " in " << fixed3(timer.readMillis()) << " ms" << endl << endl;
+}
+
+// snapshots lay records out by cs20::hash of a StreetAddress, so AddressKey tables can't be saved as one
+template<typename Allocator>
+void saveSnapshot(const HashTableClosed<AddressKey, int, Allocator>&, const SimulationOptions& options, long long) {
+    if (!options.snapshotPath.empty()) {
+        cout << "Snapshots are only saved from tables keyed by StreetAddress." << endl << endl;
+    }
+}
+
+// function to time one simulation with the given dictionary and print the results;
+// the orders are numbered from `firstOrderNum`
+template<typename DictType>
+void timeSimulation(const std::string& name, DictType& dict, const std::vector<COVIDTestOrder>& orders,
+                    const SimulationOptions& options, int firstOrderNum = 1) {
+    cout << "Running with " << name << "..." << endl;
+    if (options.tableStats) {
+        startTableStats(dict);
+    }
+    LatencyHistogram latencies;
+    std::unique_ptr<PerfCounters> counters;
+    if (options.perfCounters) {
+        counters.reset(new PerfCounters);
+    }
+    Timer timer;
+    std::unique_ptr<DecisionLog> decisions;
+    if (options.binaryAnalyze) {
+        decisions.reset(new BinaryDecisionLog(*options.analyzeLog));
+    } else if (options.analyzeLog) {
+        decisions.reset(new TextDecisionLog(*options.analyzeLog));
+    }
+    if (counters) {
+        counters->start();
+    }
+    timer.start();
+    runSimulator(orders, &dict, decisions.get(), options.recordLatencies ? &latencies : nullptr, clockFor(dict),
+                 firstOrderNum);
+    decisions.reset(); // hands the last buffer to the writer
+    timer.stop();
+    if (counters) {
+        counters->stop();
+    }
+    if (options.analyzeLog) {
+        // finish writing this run's decisions before printing anything else
+        options.analyzeLog->flush();
+    }
+    cout << name << " with " << orders.size() << " orders took "
+         << fixed3(timer.readMillis()) << " ms";
+    if (counters) {
+        cout << " (";
+        counters->print(cout, orders.size());
+        cout << ")";
+    }
+    cout << endl;
+    if (options.recordLatencies) {
+        cout << "per-order latency: ";
+        latencies.print(cout);
+        cout << endl;
+    }
+    if (options.tableStats) {
+        printTableStats(dict);
+    }
+    if (options.report) {
+        Timer reportTimer;
+        reportTimer.start();
+        HouseholdReport report = buildReport(dict);
+        reportTimer.stop();
+        report.print(cout);
+        cout << "report built in " << reportTimer.readMillis() << " ms" << endl;
+    }
+    cout << endl;
+}
+
+// functions to print where a dictionary's memory came from, when it's worth saying
+template<typename T>
+void printMemory(const std::allocator<T>&) {}
+
+template<typename T>
+void printMemory(const HugePageAllocator<T>& allocator) {
+    allocator.memory()->print(cout);
+    cout << endl;
+}
+
+// function to estimate how many distinct households `orders` come from, with one HyperLogLog pass.
+// The estimate is padded by four standard errors so it almost never falls short, and capped at the
+// number of orders; if it does fall short, the simulator grows the full table.
+int estimateHouseholds(const std::vector<COVIDTestOrder>& orders) {
+    Timer timer;
+    timer.start();
+    HyperLogLog sketch;
+    for (const COVIDTestOrder& order : orders) {
+        sketch.add(cs20::hash64(order.sa));
+    }
+    double estimate = sketch.estimate();
+    timer.stop();
+
+    double padded = std::ceil(estimate * (1 + 4 * sketch.relativeError())) + 16;
+    int households = static_cast<int>(std::min(padded, static_cast<double>(orders.size())));
+    cout << "Estimated " << static_cast<long long>(estimate + 0.5) << " distinct households in "
+         << fixed3(timer.readMillis()) << " ms, sizing for " << households << endl;
+    return households;
+}
+
+// function to work out how many slots holds `records` at a target load factor
+int capacityFor(long long records, double loadFactor) {
+    double slots = std::ceil(static_cast<double>(std::max(records, 1LL)) / loadFactor);
+    return static_cast<int>(std::min(slots, static_cast<double>(std::numeric_limits<int>::max())));
+}
+
+// function to run one simulation on a new dictionary of the chosen kind (1, 2, 3 or 5),
+// keyed by StreetAddress or by AddressKey, with the hash tables and arrays allocated by `allocator`
+// (the B+-tree always uses new); the hash tables and arrays get `capacity` slots
+template<typename Key, typename Allocator>
+void runNewDictionary(int dsChoice, int capacity, const std::vector<COVIDTestOrder>& currentOrders,
+                      const SimulationOptions& options, const Allocator& allocator) {
+    std::string keys = std::is_same<Key, AddressKey>::value ? "<AddressKey>" : "";
+    if (options.quotaWindow > 0) {
+        // the same dictionaries, holding stamped totals behind a WindowedDictionary
+        typedef WindowedEntry<int> Entry;
+        std::unique_ptr<Dictionary<Key, Entry>> table;
+        std::string name;
+        if (dsChoice == 1) {
+            table.reset(new UnsortedArrayDictionary<Key, Entry, Allocator>(capacity, allocator));
+            name = "UnsortedArrayDictionary";
+        } else if (dsChoice == 2) {
+            table.reset(new HashTableClosed<Key, Entry, Allocator>(capacity, 1, allocator));
+            name = "HashTableClosed";
+        } else if (dsChoice == 3) {
+            table.reset(new HashTableOpened<Key, Entry, Allocator>(capacity, allocator));
+            name = "HashTableOpened";
+        } else {
+            table.reset(new BPlusTree<Key, Entry>);
+            name = "BPlusTree";
+        }
+        WindowedDictionary<Key, int> windowedDict(std::move(table), options.quotaWindow);
+        timeSimulation("Windowed " + name + keys, windowedDict, currentOrders, options);
+        printMemory(allocator);
+        return;
+    }
+    if (dsChoice == 1) {
+        // using UnsortedArrayDictionary
+        UnsortedArrayDictionary<Key, int, Allocator> unsortedDict(capacity, allocator);
+        timeSimulation("UnsortedArrayDictionary" + keys, unsortedDict, currentOrders, options);
+        printMemory(allocator);
+    } else if (dsChoice == 2) {
+        // using HashTableClosed
+        HashTableClosed<Key, int, Allocator> hashDict(capacity, 1, allocator);
+        timeSimulation("HashTableClosed" + keys, hashDict, currentOrders, options);
+        printMemory(allocator);
+        saveSnapshot(hashDict, options, currentOrders.size());
+    } else if (dsChoice == 3) {
+        // using HashTableOpened
+        HashTableOpened<Key, int, Allocator> hashDict(capacity, allocator);
+        timeSimulation("HashTableOpened" + keys, hashDict, currentOrders, options);
+        printMemory(allocator);
+    } else if (dsChoice == 5) {
+        // using BPlusTree: ordered by zip, city, street, number
+        BPlusTree<Key, int> treeDict;
+        timeSimulation("BPlusTree" + keys, treeDict, currentOrders, options);
+        printZipScan(treeDict, currentOrders.front().sa.zip);
+    }
+}
+
 // function to run the main simulator loop, allowing the user to select options and run simulations
-void runSimulatorLoop(const std::vector<COVIDTestOrder>& orders, bool analyze) {
+void runSimulatorLoop(const std::vector<COVIDTestOrder>& orders, const SimulationOptions& options) {
     while (true) {
         // prompt the user to enter the number of orders to process or 'x' to exit
         cout << "Enter number of orders to process (or 'x' to exit): ";
@@ -103,56 +700,73 @@ void runSimulatorLoop(const std::vector<COVIDTestOrder>& orders, bool analyze) {
         }
 
         // prompt the user to select which data structure to use for the simulation
-        cout << "Choose data structure (1 for UnsortedArrayDictionary, 2 for HashTableClosed, 3 for HashTableOpened): ";
+        cout << "Choose data structure (1 for UnsortedArrayDictionary, 2 for HashTableClosed, 3 for HashTableOpened, "
+             << "4 for MappedHashTable restarted from a snapshot, 5 for BPlusTree): ";
         std::string dsInput;
         std::cin >> dsInput;
         int dsChoice;
         try {
             dsChoice = std::stoi(dsInput);
-            if (dsChoice != 1 && dsChoice != 2 && dsChoice != 3) {
-                std::cerr << "Invalid choice. Please enter 1, 2, or 3." << endl;
+            if (dsChoice < 1 || dsChoice > 5) {
+                std::cerr << "Invalid choice. Please enter 1, 2, 3, 4, or 5." << endl;
                 continue;
             }
         } catch (const std::exception&) {
-            std::cerr << "Invalid input. Please enter 1, 2, or 3." << endl;
+            std::cerr << "Invalid input. Please enter 1, 2, 3, 4, or 5." << endl;
             continue;
         }
 
         // create a subset of orders to process based on user-specified M
         std::vector<COVIDTestOrder> currentOrders(orders.begin(), orders.begin() + M);
 
-        Timer timer;
-        int elapsed;
-
         // run the simulation using the selected data structure
         try {
-            if (dsChoice == 1) {
-                // using UnsortedArrayDictionary
-                cout << "Running with UnsortedArrayDictionary..." << endl;
-                UnsortedArrayDictionary<StreetAddress, int> unsortedDict(4 * M); // array dictionary size is 4 * M
-                timer.start();
-                runSimulator(currentOrders, &unsortedDict, analyze);
-                timer.stop();
-                elapsed = timer.read();
-                cout << "UnsortedArrayDictionary with " << M << " orders took " << elapsed << " ms" << endl << endl;
-            } else if (dsChoice == 2) {
-                // using HashTableClosed
-                cout << "Running with HashTableClosed..." << endl;
-                HashTableClosed<StreetAddress, int> hashDict(4 * M); // hash table size is 4 * M
-                timer.start();
-                runSimulator(currentOrders, &hashDict, analyze);
-                timer.stop();
-                elapsed = timer.read();
-                cout << "HashTableClosed with " << M << " orders took " << elapsed << " ms" << endl << endl;
-            } else if (dsChoice == 3) {
-                // using HashTableOpened
-                cout << "Running with HashTableOpened..." << endl;
-                HashTableOpened<StreetAddress, int> hashDict(4 * M); // hash table size is 4 * M
-                timer.start();
-                runSimulator(currentOrders, &hashDict, analyze);
-                timer.stop();
-                elapsed = timer.read();
-                cout << "HashTableOpened with " << M << " orders took " << elapsed << " ms" << endl << endl;
+            // new tables get room for every order to be a new household, at a load factor of 1/4,
+            // unless they are sized from an estimate of the distinct households
+            int capacity = 4 * M;
+            if (options.loadFactor > 0 && dsChoice != 4 && dsChoice != 5) {
+                capacity = capacityFor(estimateHouseholds(currentOrders), options.loadFactor);
+            }
+            if (dsChoice == 4) {
+                // using MappedHashTable: the totals saved by an earlier run, continued with the next M orders
+                cout << "Enter snapshot file to restart from: ";
+                std::string path;
+                std::cin >> path;
+                Timer loadTimer;
+                loadTimer.start();
+                MappedHashTable mappedDict(path);
+                loadTimer.stop();
+                long long resumeAt = mappedDict.ordersProcessed();
+                cout << "Mapped snapshot of " << mappedDict.size() << " households (" << resumeAt
+                     << " orders) in " << fixed3(loadTimer.readMillis()) << " ms" << endl;
+                if (resumeAt + M > static_cast<long long>(orders.size())) {
+                    std::cerr << "The snapshot already covers " << resumeAt << " orders; only "
+                              << orders.size() - std::min<long long>(resumeAt, orders.size())
+                              << " are left to continue with." << endl;
+                    continue;
+                }
+                // the orders after the ones the snapshot's totals already include
+                std::vector<COVIDTestOrder> resumedOrders(orders.begin() + resumeAt, orders.begin() + resumeAt + M);
+                if (options.loadFactor > 0) {
+                    // grow the snapshot's table if the new households could push it past the target load
+                    long long households = static_cast<long long>(mappedDict.size()) + estimateHouseholds(resumedOrders);
+                    mappedDict.reserve(capacityFor(households, options.loadFactor));
+                }
+                timeSimulation("MappedHashTable", mappedDict, resumedOrders, options, static_cast<int>(resumeAt) + 1);
+                mappedDict.setOrdersProcessed(resumeAt + M);
+                saveSnapshot(mappedDict, options);
+            } else if (options.inlineKeys && options.hugePages) {
+                runNewDictionary<AddressKey>(dsChoice, capacity, currentOrders, options,
+                                             HugePageAllocator<std::pair<const AddressKey, int>>());
+            } else if (options.inlineKeys) {
+                runNewDictionary<AddressKey>(dsChoice, capacity, currentOrders, options,
+                                             std::allocator<std::pair<const AddressKey, int>>());
+            } else if (options.hugePages) {
+                runNewDictionary<StreetAddress>(dsChoice, capacity, currentOrders, options,
+                                                HugePageAllocator<std::pair<const StreetAddress, int>>());
+            } else {
+                runNewDictionary<StreetAddress>(dsChoice, capacity, currentOrders, options,
+                                                std::allocator<std::pair<const StreetAddress, int>>());
             }
         } catch (const std::exception& e) {
             std::cerr << "An error occurred during simulation: " << e.what() << endl;
@@ -229,6 +843,608 @@ void runTests() {
         cout << "Insert until full test passed: " << e.what() << endl;
     }
 
+    // test that the statistics agree with the table contents
+    HashTableStats stats = hashTable.stats();
+    if (stats.records == hashTable.size() && stats.tombstones == 1 && stats.capacity == 10 && stats.maxProbeLength >= 1) {
+        cout << "Stats test passed." << endl;
+    } else {
+        std::cerr << "Stats test failed: " << stats.records << " records, " << stats.tombstones << " tombstones." << endl;
+    }
+
+    // test that the B+-tree keeps its records in order through splits and merges
+    BPlusTree<int, int> tree;
+    for (int i = 0; i < 1000; i++) {
+        tree.insert((i * 7919) % 1000, i);
+    }
+    for (int i = 0; i < 1000; i += 2) {
+        tree.remove(i);
+    }
+    int previous = -1;
+    bool ordered = true;
+    tree.forEach([&](const int& key, const int&) {
+        ordered = ordered && key > previous && key % 2 == 1;
+        previous = key;
+    });
+    int inRange = 0;
+    tree.rangeScan(100, 199, [&](const int&, const int&) { inRange++; });
+    if (ordered && tree.size() == 500 && inRange == 50) {
+        cout << "B+-tree test passed." << endl;
+    } else {
+        std::cerr << "B+-tree test failed: " << tree.size() << " records, " << inRange << " in range." << endl;
+    }
+
+    // test that inline address keys survive a round trip, including names too long to store inline
+    StreetAddress longAddress{12, "Avenue of the Extremely Long Street Names", "San Francisco", 94110};
+    StreetAddress shortAddress{12, "Cliff Ln", "Union City", 95533};
+    AddressKey longKey(longAddress);
+    AddressKey shortKey(shortAddress);
+    HashTableClosed<AddressKey, int> keyTable(10);
+    keyTable.insert(longKey, 1);
+    keyTable.insert(shortKey, 2);
+    // pooled names must read back correctly while other threads are adding more (past the first chunk)
+    auto longName = [](int i) { return "Extremely Long Street Number " + std::to_string(i); };
+    std::vector<AddressKey> pooled;
+    for (int i = 0; i < 5000; i++) {
+        pooled.push_back(AddressKey(StreetAddress{i, longName(i), "San Francisco", 94110}));
+    }
+    bool pooledIntact = true;
+    std::thread pooling([&longName] {
+        for (int i = 5000; i < 10000; i++) {
+            AddressKey(StreetAddress{i, longName(i), "San Francisco", 94110});
+        }
+    });
+    for (int i = 0; i < 5000; i++) {
+        pooledIntact = pooledIntact && pooled[i].streetName() == longName(i);
+    }
+    pooling.join();
+    if (pooledIntact && longKey.toStreetAddress() == longAddress && shortKey.toStreetAddress() == shortAddress &&
+        AddressKey(longAddress) == longKey && !(longKey == shortKey) &&
+        keyTable.find(AddressKey(longAddress)) == 1 && keyTable.find(AddressKey(shortAddress)) == 2 &&
+        (shortKey < longKey) == (shortAddress < longAddress)) {
+        cout << "Address key test passed." << endl;
+    } else {
+        std::cerr << "Address key test failed." << endl;
+    }
+
+    // test that windowed records expire and get reclaimed as the clock moves on
+    std::unique_ptr<Dictionary<int, WindowedEntry<int>>> windowTable(new HashTableOpened<int, WindowedEntry<int>>(10));
+    WindowedDictionary<int, int> windowed(std::move(windowTable), 8);
+    windowed.insert(1, 10);
+    windowed.advance(5);
+    windowed.insert(2, 20);
+    windowed.insert(1, 11);
+    windowed.advance(10);
+    bool firstExpired = false;
+    try {
+        windowed.find(1);
+    } catch (const std::exception&) {
+        firstExpired = true;
+    }
+    // a miss remembered for the next insert must not be mistaken for a different key later passed in
+    // the same object, and must not survive clear()
+    bool expiredOnTime = firstExpired && windowed.size() == 1 && windowed.find(2) == 20;
+    int reused = 2;
+    windowed.insert(reused, 21);
+    reused = 3;
+    try {
+        windowed.find(reused);
+    } catch (const std::exception&) {
+        // not there
+    }
+    reused = 2;
+    windowed.insert(reused, 22);
+    bool updatedInPlace = windowed.size() == 1 && windowed.find(2) == 22;
+    try {
+        windowed.find(reused = 4);
+    } catch (const std::exception&) {
+        // not there
+    }
+    windowed.clear();
+    windowed.insert(reused, 40);
+    windowed.insert(reused, 41);
+    updatedInPlace = updatedInPlace && windowed.size() == 1 && windowed.find(4) == 41;
+    // the same with two addresses built to have the same hash, reusing one address object
+    OrderGenerator collidingOrders(OrderGeneratorConfig(2, 0, true, 1));
+    std::vector<COVIDTestOrder> colliding = collidingOrders.generate(20);
+    StreetAddress first = colliding[0].sa;
+    StreetAddress second = first;
+    for (const COVIDTestOrder& order : colliding) {
+        if (!(order.sa == first)) {
+            second = order.sa;
+        }
+    }
+    std::unique_ptr<Dictionary<StreetAddress, WindowedEntry<int>>> collidingTable(
+        new HashTableClosed<StreetAddress, WindowedEntry<int>>(16));
+    WindowedDictionary<StreetAddress, int> windowedAddresses(std::move(collidingTable), 8);
+    StreetAddress address = first;
+    windowedAddresses.insert(address, 1);
+    address = second;
+    try {
+        windowedAddresses.find(address);
+    } catch (const std::exception&) {
+        // not there
+    }
+    address = first;
+    windowedAddresses.insert(address, 2);
+    updatedInPlace = updatedInPlace && !(first == second) && cs20::hash(first) == cs20::hash(second) &&
+                     windowedAddresses.size() == 1 && windowedAddresses.find(first) == 2;
+    if (expiredOnTime && updatedInPlace) {
+        cout << "Windowed dictionary test passed." << endl;
+    } else {
+        std::cerr << "Windowed dictionary test failed: " << windowed.size() << " live records." << endl;
+    }
+
+    // test that a chained table works the same on huge-page memory, reusing freed nodes
+    HashTableOpened<int, int, HugePageAllocator<std::pair<const int, int>>> hugeTable(64);
+    for (int i = 0; i < 1000; i++) {
+        hugeTable.insert(i, i * 2);
+    }
+    for (int i = 0; i < 1000; i += 2) {
+        hugeTable.remove(i);
+    }
+    for (int i = 1000; i < 1500; i++) {
+        hugeTable.insert(i, i * 2);
+    }
+    if (hugeTable.size() == 1000 && hugeTable.find(999) == 1998 && hugeTable.find(1499) == 2998) {
+        cout << "Huge-page allocator test passed." << endl;
+    } else {
+        std::cerr << "Huge-page allocator test failed: " << hugeTable.size() << " records." << endl;
+    }
+
+    // test that the sketch's estimate of distinct households is close, however often they repeat
+    HyperLogLog sketch;
+    for (int repeat = 0; repeat < 3; repeat++) {
+        for (int i = 0; i < 50000; i++) {
+            sketch.add(cs20::hash64(StreetAddress{i, "Main St", "Springfield", 90000 + i % 100}));
+        }
+    }
+    double estimate = sketch.estimate();
+    if (std::fabs(estimate - 50000) < 50000 * 4 * sketch.relativeError()) {
+        cout << "HyperLogLog test passed." << endl;
+    } else {
+        std::cerr << "HyperLogLog test failed: estimated " << estimate << " of 50000." << endl;
+    }
+
+    // test that reserve() grows every table without losing records, and lets a full one take more
+    HashTableClosed<int, int> closedGrow(8);
+    HashTableOpened<int, int> openedGrow(8);
+    UnsortedArrayDictionary<int, int> arrayGrow(8);
+    std::vector<Dictionary<int, int>*> growing = {&closedGrow, &openedGrow, &arrayGrow};
+    bool reserved = true;
+    for (Dictionary<int, int>* dict : growing) {
+        for (int i = 0; i < 8; i++) {
+            dict->insert(i * 7, i);
+        }
+        dict->remove(0);
+        dict->reserve(4);  // never shrinks
+        dict->reserve(64);
+        for (int i = 8; i < 40; i++) {
+            dict->insert(i * 7, i);
+        }
+        reserved = reserved && dict->size() == 39 && dict->find(49) == 7 && dict->find(273) == 39;
+    }
+    if (reserved && closedGrow.slotCount() == 64 && openedGrow.slotCount() == 64) {
+        cout << "Reserve test passed." << endl;
+    } else {
+        std::cerr << "Reserve test failed." << endl;
+    }
+
+    // test that a run on tables sized from far too low a household estimate still completes,
+    // growing them when they fill up, with the same totals as a table with room for every order
+    OrderGenerator shortOrders(OrderGeneratorConfig(3000, 1, false, 3));
+    std::vector<COVIDTestOrder> underestimated = shortOrders.generate(6000);
+    HashTableClosed<StreetAddress, int> roomy(4 * static_cast<int>(underestimated.size()));
+    HashTableClosed<StreetAddress, int> closedShort(50);
+    UnsortedArrayDictionary<StreetAddress, int> arrayShort(50);
+    HashTableClosed<AddressKey, int> keyedShort(50);
+    bool completed = true;
+    try {
+        runSimulator(underestimated, &roomy, nullptr);
+        runSimulator(underestimated, &closedShort, nullptr);
+        runSimulator(underestimated, &arrayShort, nullptr);
+        runSimulator(underestimated, &keyedShort, nullptr);
+    } catch (const std::exception& e) {
+        std::cerr << "Under-estimate test: " << e.what() << endl;
+        completed = false;
+    }
+    bool sameTotals = completed && closedShort.size() == roomy.size() && arrayShort.size() == roomy.size() &&
+                      keyedShort.size() == roomy.size();
+    if (sameTotals) {
+        roomy.forEach([&](const StreetAddress& address, const int& kits) {
+            sameTotals = sameTotals && closedShort.find(address) == kits && arrayShort.find(address) == kits &&
+                         keyedShort.find(AddressKey(address)) == kits;
+        });
+    }
+    if (sameTotals && closedShort.slotCount() > 50) {
+        cout << "Under-estimate test passed." << endl;
+    } else {
+        std::cerr << "Under-estimate test failed: " << closedShort.size() << " of " << roomy.size()
+                  << " households." << endl;
+    }
+
+    // test that the generator gives the same orders for the same seed (and different ones otherwise),
+    // and that households stay distinct in both address modes
+    bool deterministic = true;
+    for (bool colliding : {false, true}) {
+        OrderGenerator first(OrderGeneratorConfig(1000, 1.0, colliding, 42));
+        OrderGenerator second(OrderGeneratorConfig(1000, 1.0, colliding, 42));
+        OrderGenerator other(OrderGeneratorConfig(1000, 1.0, colliding, 43));
+        std::vector<COVIDTestOrder> a = first.generate(500);
+        std::vector<COVIDTestOrder> b = second.generate(500);
+        std::vector<COVIDTestOrder> c = other.generate(500);
+        bool differs = false;
+        for (int i = 0; i < 500; i++) {
+            deterministic = deterministic && a[i].sa == b[i].sa && a[i].numOrdered == b[i].numOrdered;
+            differs = differs || !(a[i].sa == c[i].sa);
+        }
+        deterministic = deterministic && differs && !(first.addressFor(7) == first.addressFor(8)) &&
+                        first.addressFor(OrderGenerator::MAX_DISTINCT_ADDRESSES + 7) == first.addressFor(7);
+        if (colliding) {
+            deterministic = deterministic && cs20::hash(a[0].sa) == cs20::hash(a[1].sa);
+        }
+    }
+    bool rejected = false;
+    try {
+        OrderGenerator tooMany(OrderGeneratorConfig(OrderGenerator::MAX_DISTINCT_ADDRESSES + 1));
+    } catch (const std::invalid_argument&) {
+        rejected = true;
+    }
+    if (deterministic && rejected) {
+        cout << "Order generator test passed." << endl;
+    } else {
+        std::cerr << "Order generator test failed." << endl;
+    }
+
+    // test that a binary decision log expands to exactly the text log of the same decisions
+    // (across more than one block), and that a log cut off after a block header is rejected
+    // before anything from that block is written
+    OrderGenerator logOrders(OrderGeneratorConfig(1000, 0, false, 7));
+    std::vector<COVIDTestOrder> decided = logOrders.generate(BinaryDecisionLog::BLOCK_ORDERS + 100);
+    char textPath[] = "/tmp/decisions-text-XXXXXX";
+    char binaryPath[] = "/tmp/decisions-binary-XXXXXX";
+    char expandedPath[] = "/tmp/decisions-expanded-XXXXXX";
+    {
+        AsyncLogSink textSink(mkstemp(textPath), true);
+        AsyncLogSink binarySink(mkstemp(binaryPath), true);
+        TextDecisionLog textLog(textSink);
+        BinaryDecisionLog binaryLog(binarySink);
+        for (int i = 0; i < static_cast<int>(decided.size()); i++) {
+            textLog.record(i + 1, decided[i], i % 3 != 0, i % 16);
+            binaryLog.record(i + 1, decided[i], i % 3 != 0, i % 16);
+        }
+    }
+    auto slurp = [](const char* path) {
+        std::ifstream file(path, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    };
+    std::string binary = slurp(binaryPath);
+    long long expandedCount = 0;
+    {
+        AsyncLogSink expandedSink(mkstemp(expandedPath), true);
+        std::istringstream in(binary);
+        expandedCount = expandDecisionLog(in, decided, expandedSink);
+    }
+    bool roundTrip = expandedCount == static_cast<long long>(decided.size()) && slurp(expandedPath) == slurp(textPath);
+    bool truncationCaught = false;
+    {
+        AsyncLogSink expandedSink(open(expandedPath, O_WRONLY | O_TRUNC), true);
+        std::istringstream in(binary.substr(0, 16)); // run header and block header only
+        try {
+            expandDecisionLog(in, decided, expandedSink);
+        } catch (const std::runtime_error&) {
+            truncationCaught = true;
+        }
+    }
+    truncationCaught = truncationCaught && slurp(expandedPath).empty();
+    std::remove(textPath);
+    std::remove(binaryPath);
+    std::remove(expandedPath);
+    if (roundTrip && truncationCaught) {
+        cout << "Decision log test passed." << endl;
+    } else {
+        std::cerr << "Decision log test failed: " << expandedCount << " decisions expanded." << endl;
+    }
+
+    // test that a sink reports a failed write once, keeps going, and writes later text once its fd
+    // works again
+    char sinkPath[] = "/tmp/sink-recovery-XXXXXX";
+    int writable = mkstemp(sinkPath);
+    int flaky = open("/dev/null", O_RDONLY); // writes fail until a writable file is put in its place
+    bool failureReported = false;
+    bool recovered = false;
+    {
+        AsyncLogSink sink(flaky, true);
+        {
+            AsyncLogSink::Producer producer(sink);
+            producer.append("lost\n");
+        }
+        try {
+            sink.flush();
+        } catch (const std::runtime_error&) {
+            failureReported = true;
+        }
+        dup2(writable, flaky);
+        {
+            AsyncLogSink::Producer producer(sink);
+            producer.append("kept\n");
+        }
+        try {
+            sink.flush();
+            recovered = true;
+        } catch (const std::runtime_error&) {
+        }
+    }
+    close(writable);
+    recovered = recovered && slurp(sinkPath) == "kept\n";
+    std::remove(sinkPath);
+    if (failureReported && recovered) {
+        cout << "Log sink recovery test passed." << endl;
+    } else {
+        std::cerr << "Log sink recovery test failed." << endl;
+    }
+
+    // test that a saved table maps back with the same totals and order count, that a mapped table
+    // still takes new households after growing, and that a slot flag no table writes is rejected
+    HashTableClosed<StreetAddress, int> saved(16);
+    for (int i = 0; i < 6; i++) {
+        saved.insert(decided[i].sa, i + 1);
+    }
+    saved.remove(decided[0].sa);
+    char snapshotPath[] = "/tmp/snapshot-XXXXXX";
+    close(mkstemp(snapshotPath));
+    MappedHashTable::save(saved, snapshotPath, 6);
+    bool mappedBack = false;
+    {
+        MappedHashTable mapped(snapshotPath);
+        mappedBack = mapped.size() == saved.size() && mapped.ordersProcessed() == 6;
+        for (int i = 1; i < 6; i++) {
+            mappedBack = mappedBack && mapped.find(decided[i].sa) == saved.find(decided[i].sa);
+        }
+        mapped.reserve(64);
+        mapped.insert(decided[0].sa, 100);
+        mappedBack = mappedBack && mapped.size() == saved.size() + 1 && mapped.find(decided[0].sa) == 100 &&
+                     mapped.find(decided[5].sa) == saved.find(decided[5].sa);
+    }
+    // the flag array is stored one byte per slot, so find it by its contents and spoil one flag;
+    // then, with the flags intact, move the header's offset of them so far past the end of the file
+    // that offset + capacity wraps around to 0
+    std::string snapshot = slurp(snapshotPath);
+    std::string intact = snapshot;
+    std::string savedFlags;
+    for (int i = 0; i < saved.capacity(); i++) {
+        savedFlags += static_cast<char>(saved.slotType(i));
+    }
+    std::size_t flagsAt = snapshot.find(savedFlags);
+    bool corruptionCaught = false;
+    if (flagsAt != std::string::npos) {
+        snapshot[flagsAt] = 7;
+        std::ofstream(snapshotPath, std::ios::binary | std::ios::trunc) << snapshot;
+        try {
+            MappedHashTable corrupt(snapshotPath);
+        } catch (const std::runtime_error&) {
+            corruptionCaught = true;
+        }
+        std::uint64_t offset = flagsAt;
+        std::size_t field = intact.substr(0, 128).find(std::string(reinterpret_cast<const char*>(&offset), sizeof(offset)));
+        bool wrapCaught = false;
+        if (field != std::string::npos) {
+            offset = 0 - static_cast<std::uint64_t>(saved.capacity()); // offset + capacity wraps to 0
+            intact.replace(field, sizeof(offset), reinterpret_cast<const char*>(&offset), sizeof(offset));
+            std::ofstream(snapshotPath, std::ios::binary | std::ios::trunc) << intact;
+            try {
+                MappedHashTable corrupt(snapshotPath);
+            } catch (const std::runtime_error&) {
+                wrapCaught = true;
+            }
+        }
+        corruptionCaught = corruptionCaught && wrapCaught;
+    }
+    std::remove(snapshotPath);
+    if (mappedBack && corruptionCaught) {
+        cout << "Snapshot test passed." << endl;
+    } else {
+        std::cerr << "Snapshot test failed." << endl;
+    }
+
+    // test the order server over socketpairs: a request split across many writes is framed correctly,
+    // a client that shuts down its end after more requests than the socket buffers hold still gets
+    // every answer, and a malformed request gets the answers due before it and then an error.
+    // A client that sends more than a megabyte of answers' worth of requests before reading any still
+    // gets them all, including the ones held back while that output was waiting. Then a load generator
+    // with every order in flight at once must complete against the server's back-pressure (over 1MB
+    // of responses).
+    std::signal(SIGPIPE, SIG_IGN);
+    OrderGenerator serverOrders(OrderGeneratorConfig(50000, 0, false, 11));
+    std::vector<COVIDTestOrder> requests = serverOrders.generate(200000);
+    HashTableClosed<StreetAddress, int> servedTotals(100003);
+    HashTableClosed<StreetAddress, int> expectedTotals(100003); // the same orders, applied directly
+    int pairs[4][2];
+    for (auto& pair : pairs) {
+        socketpair(AF_UNIX, SOCK_STREAM, 0, pair);
+    }
+    int smallBuffer = 8192; // so answers are still queued at the server when the client shuts down
+    setsockopt(pairs[1][0], SOL_SOCKET, SO_SNDBUF, &smallBuffer, sizeof(smallBuffer));
+    setsockopt(pairs[3][0], SOL_SOCKET, SO_SNDBUF, &smallBuffer, sizeof(smallBuffer));
+    auto sendAll = [](int fd, const std::string& data, std::size_t chunk) {
+        for (std::size_t done = 0; done < data.size(); done += chunk) {
+            if (write(fd, data.data() + done, std::min(chunk, data.size() - done)) < 0) {
+                return false;
+            }
+            if (chunk < data.size()) {
+                usleep(100); // let the server see the partial requests
+            }
+        }
+        return true;
+    };
+    // reads until the server closes the connection; true if the answers match `expected` (then an error if `error`)
+    auto answersMatch = [](int fd, const std::vector<int>& expected, bool error) {
+        std::string in;
+        char buffer[64 * 1024];
+        ssize_t n;
+        while ((n = read(fd, buffer, sizeof(buffer))) > 0) {
+            in.append(buffer, static_cast<std::size_t>(n));
+        }
+        std::vector<int> totals;
+        bool errorSeen = false;
+        std::size_t consumed = 0;
+        const char* payload;
+        std::size_t payloadBytes;
+        while (std::size_t size = OrderProtocol::nextMessage(in.data() + consumed, in.size() - consumed,
+                                                             payload, payloadBytes)) {
+            bool accepted;
+            int total;
+            try {
+                OrderProtocol::decodeResponse(payload, payloadBytes, accepted, total);
+                totals.push_back(total);
+            } catch (const std::runtime_error&) {
+                errorSeen = true;
+            }
+            consumed += size;
+        }
+        return consumed == in.size() && totals == expected && errorSeen == error;
+    };
+    // encodes orders [begin, end) and works out the totals the server should answer with
+    auto encodeOrders = [&](int begin, int end, std::string& out, std::vector<int>& expected) {
+        for (int i = begin; i < end; i++) {
+            OrderProtocol::encodeRequest(requests[i], out);
+            int total = 0;
+            processOrder(&expectedTotals, requests[i], total);
+            expected.push_back(total);
+        }
+    };
+    bool framing = false, halfClose = false, errorReply = false, backPressure = false;
+    LoadReport load;
+    try {
+        std::string serverPath = "/tmp/order-server-test-" + std::to_string(getpid());
+        OrderServer server(serverPath, &servedTotals);
+        for (auto& pair : pairs) {
+            server.adopt(pair[0]);
+        }
+        // the server thread is stopped the way runServer is, by a signal handled on that thread
+        stopServer = 0;
+        std::signal(SIGUSR1, requestServerStop);
+        std::thread serving([&server] { server.run(stopServer); });
+        try {
+            std::string out;
+            std::vector<int> expected;
+            encodeOrders(0, 3, out, expected);
+            framing = sendAll(pairs[0][1], out, 7) && shutdown(pairs[0][1], SHUT_WR) == 0 &&
+                      answersMatch(pairs[0][1], expected, false);
+
+            out.clear();
+            expected.clear();
+            encodeOrders(3, 20003, out, expected);
+            halfClose = sendAll(pairs[1][1], out, out.size()) && shutdown(pairs[1][1], SHUT_WR) == 0;
+            usleep(50000); // let the server see the shutdown before any answers are read
+            halfClose = halfClose && answersMatch(pairs[1][1], expected, false);
+
+            out.clear();
+            expected.clear();
+            encodeOrders(20003, 20004, out, expected);
+            out += std::string("\3\0\0\0abc", 7); // too short for a request
+            errorReply = sendAll(pairs[2][1], out, out.size()) && answersMatch(pairs[2][1], expected, true);
+
+            out.clear();
+            expected.clear();
+            int heldBack = 20004 + (1 << 20) / 9 + 3000; // a little over a megabyte of answers
+            encodeOrders(20004, heldBack, out, expected);
+            bool allSent = false;
+            std::thread sender([&] {
+                allSent = sendAll(pairs[3][1], out, out.size()) && shutdown(pairs[3][1], SHUT_WR) == 0;
+            });
+            usleep(100000); // let the server stop at its output limit with the last requests unanswered
+            backPressure = answersMatch(pairs[3][1], expected, false);
+            sender.join();
+            backPressure = backPressure && allSent;
+
+            load = runLoad(serverPath, requests, static_cast<int>(requests.size()));
+        } catch (const std::exception& e) {
+            std::cerr << "Order server test: " << e.what() << endl;
+        }
+        pthread_kill(serving.native_handle(), SIGUSR1);
+        serving.join();
+    } catch (const std::exception& e) {
+        std::cerr << "Order server test: " << e.what() << endl;
+    }
+    for (auto& pair : pairs) {
+        close(pair[1]);
+    }
+    if (framing && halfClose && errorReply && backPressure && load.requests == static_cast<long long>(requests.size())) {
+        cout << "Order server test passed." << endl;
+    } else {
+        std::cerr << "Order server test failed: framing " << framing << ", half-close " << halfClose
+                  << ", error reply " << errorReply << ", back-pressure " << backPressure << ", "
+                  << load.requests << " loaded." << endl;
+    }
+
+    // test that a report built by several threads matches one built serially for every dictionary,
+    // before and after removals (which merge B+-tree leaves)
+    OrderGenerator reportOrders(OrderGeneratorConfig(2000, 1, false, 5));
+    std::vector<COVIDTestOrder> reported = reportOrders.generate(5000);
+    UnsortedArrayDictionary<StreetAddress, int> arrayReport(4000);
+    HashTableClosed<StreetAddress, int> closedReport(4001);
+    HashTableOpened<StreetAddress, int> openedReport(4001);
+    BPlusTree<StreetAddress, int> treeReport;
+    std::vector<Dictionary<StreetAddress, int>*> reporting = {&arrayReport, &closedReport, &openedReport, &treeReport};
+    auto sameAreas = [](const AreaTotals& a, const AreaTotals& b) {
+        return a.households == b.households && a.kits == b.kits && a.atCap == b.atCap;
+    };
+    auto sameReport = [&sameAreas](const HouseholdReport& a, const HouseholdReport& b) {
+        return a.households == b.households && a.kits == b.kits && a.distribution == b.distribution &&
+               std::equal(a.byZip.begin(), a.byZip.end(), b.byZip.begin(), b.byZip.end(),
+                          [&sameAreas](const std::pair<const int, AreaTotals>& x, const std::pair<const int, AreaTotals>& y) {
+                              return x.first == y.first && sameAreas(x.second, y.second);
+                          }) &&
+               std::equal(a.byCity.begin(), a.byCity.end(), b.byCity.begin(), b.byCity.end(),
+                          [&sameAreas](const std::pair<const std::string, AreaTotals>& x,
+                                       const std::pair<const std::string, AreaTotals>& y) {
+                              return x.first == y.first && sameAreas(x.second, y.second);
+                          });
+    };
+    bool parallelMatches = true;
+    for (Dictionary<StreetAddress, int>* dict : reporting) {
+        for (const COVIDTestOrder& order : reported) {
+            int total = 0;
+            processOrder(dict, order, total);
+        }
+        for (int round = 0; round < 2; round++) {
+            HouseholdReport serial = buildReport(*dict, 1);
+            parallelMatches = parallelMatches && serial.households == dict->size() &&
+                              sameReport(serial, buildReport(*dict, 3)) && sameReport(serial, buildReport(*dict, 8));
+            for (int i = 0; i < 1500; i++) {
+                try {
+                    dict->remove(reported[i].sa);
+                } catch (const std::runtime_error&) {
+                    // already removed
+                }
+            }
+        }
+    }
+    if (parallelMatches && treeReport.slotCount() > 8) {
+        cout << "Parallel report test passed." << endl;
+    } else {
+        std::cerr << "Parallel report test failed." << endl;
+    }
+
+    // test that the histogram keeps small values exact and larger ones within a bucket's width
+    // (1001 values, 0 .. 1000: the 10th percentile is the 100th smallest, 99)
+    LatencyHistogram histogram;
+    for (long long value = 1; value <= 1000; value++) {
+        histogram.record(value);
+    }
+    LatencyHistogram more;
+    more.record(-5);
+    histogram.merge(more);
+    long long median = histogram.percentile(50);
+    if (histogram.count() == 1001 && histogram.min() == 0 && histogram.max() == 1000 &&
+        histogram.percentile(10) == 99 && median >= 500 && median <= 508 &&
+        histogram.percentile(100) == 1000) {
+        cout << "Latency histogram test passed." << endl;
+    } else {
+        std::cerr << "Latency histogram test failed: p10=" << histogram.percentile(10)
+                  << " p50=" << median << endl;
+    }
+
     // optionally, print the hash table contents for verification
     cout << "\nCurrent hash table contents:" << endl;
     hashTable.print();